@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "consoleevent.hpp"
+#include "textmap.hpp"
+
+
+
+
+namespace
+{
+
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+
+/** bench_render
+ *
+ * Replays frames of styled text and blank runs in the full palette and
+ * prints the bytes the cost model predicted against the bytes written.
+ */
+void bench_render(unsigned frames)
+{
+    STDIOTextArea area({200, 60});
+    std::mt19937 rng(1);
+    auto pick = [&](unsigned count) { return unsigned(rng() % count); };
+
+    std::string frame;
+    size_t sent = 0;
+    auto start = Clock::now();
+    for (unsigned f = 0; f < frames; f++) {
+        for (unsigned k = 0; k < 40; k++) {
+            CharUnit::Meta meta{CharColor256Bg{uint8_t(pick(256))}, CharColor256Fg{uint8_t(pick(256))},
+                                uint16_t(pick(4) ? 0 : 1u << pick(12))};
+            Vector2u pos{pick(area.size.x), pick(area.size.y)};
+            unsigned length = 1 + pick(40);
+            if (pick(3) == 0) {
+                area.fill_rect({pos, {length, 1 + pick(4)}}, CharUnit{L' ', meta});
+                continue;
+            }
+            std::string text(length, ' ');
+            for (auto& chr : text)
+                chr = char('!' + pick(94));
+            ::draw(&area, pos, text, meta);
+        }
+        frame.clear();
+        frame = area.print_frame(std::move(frame));
+        sent += frame.size();
+    }
+    auto ms = elapsed_ms(start);
+
+    auto& stats = area.render_stats();
+    printf("render: %llu frames of %ux%u in %.1f ms\n", (unsigned long long)stats.frames,
+           area.size.x, area.size.y, ms);
+    printf("  estimated %llu B, written %llu B, %s\n",
+           (unsigned long long)stats.estimated_bytes, (unsigned long long)stats.written_bytes,
+           stats.estimated_bytes == stats.written_bytes ? "exact" : "MISMATCH");
+    printf("  sent %zu B with the synchronized update markers\n", sent);
+}
+
+
+/** bench_resize
+ *
+ * A terminal corner dragged between 150x40 and 250x70 and back, a column
+ * and every other step a row at a time, clipped and reflowed.
+ */
+void bench_resize(unsigned steps, bool reflow)
+{
+    TextMap map({150, 40});
+    for (unsigned y = 0; y < map.size.y; y++)
+        ::draw(&map, {0, y}, std::string(map.size.x - y % 7 * 10, char('a' + y % 26)));
+
+    Vector2u size = map.size;
+    int dir = 1;
+    auto start = Clock::now();
+    for (unsigned i = 0; i < steps; i++) {
+        if ((dir > 0 and size.x == 250) or (dir < 0 and size.x == 150))
+            dir = -dir;
+        size.x += dir;
+        if (i % 2)
+            size.y = std::clamp<unsigned>(size.y + dir, 40, 70);
+        map.resize(size, reflow);
+    }
+    printf("resize: %u steps %s in %.1f ms\n", steps, reflow ? "reflowed" : "clipped", elapsed_ms(start));
+}
+
+
+/// Counts what the sender delivers
+class CountingReceiver : public ConsoleEventReceiver
+{
+public:
+    void on_event(const conevent::MouseMoveEvent&) override { ++events; }
+    void on_event(const conevent::MouseButtonEvent&) override { ++events; }
+    void on_event(const conevent::KeyboardEvent&) override { ++events; }
+    void on_event(const conevent::TextInputEvent& event) override { ++events; chars += event.text.size(); }
+    void on_event(const conevent::PasteEvent& event) override { ++events; chars += event.text.size(); }
+
+public:
+    size_t events = 0;
+    size_t chars = 0;
+};
+
+
+/// Feeds `input` in reads of up to 64 KiB, as the event loops do
+void feed(const char* name, const std::string& input, unsigned rounds)
+{
+    CountingReceiver receiver;
+    XTermConsoleEventSender sender(receiver);
+    constexpr size_t read_size = 1 << 16;
+    auto start = Clock::now();
+    for (unsigned r = 0; r < rounds; r++)
+        for (size_t i = 0; i < input.size(); i += read_size)
+            sender.on_bytes({input.data() + i, std::min(read_size, input.size() - i)});
+    auto ms = elapsed_ms(start);
+    double mb = double(input.size()) * rounds / (1 << 20);
+    printf("input %s: %.1f MB in %.1f ms, %.0f MB/s, %zu events, %zu chars\n",
+           name, mb, ms, mb / ms * 1000, receiver.events, receiver.chars);
+}
+
+
+/** bench_input
+ *
+ * A bracketed paste of lines, typed ASCII and UTF-8 text, and a stream of
+ * SGR mouse reports and cursor keys mixed with typed text.
+ */
+void bench_input(unsigned rounds)
+{
+    std::string paste = "\e[200~";
+    for (unsigned i = 0; paste.size() < (2u << 20); i++)
+        paste += "pasted line " + std::to_string(i) + " with some words in it\n";
+    paste += "\e[201~";
+    feed("paste", paste, rounds);
+
+    std::string text;
+    while (text.size() < (2u << 20))
+        text += "typed ascii text, \xd1\x82\xd0\xb5\xd0\xba\xd1\x81\xd1\x82 \xe2\x86\x92 \xf0\x9f\x99\x82 ";
+    feed("text", text, rounds);
+
+    std::string mixed;
+    for (unsigned i = 0; mixed.size() < (2u << 20); i++) {
+        mixed += "\e[<35;" + std::to_string(i % 200 + 1) + ";" + std::to_string(i % 60 + 1) + "M";
+        if (i % 8 == 0)
+            mixed += "\e[A\e[1;5C";
+        if (i % 16 == 0)
+            mixed += "abc\r";
+    }
+    feed("mixed", mixed, rounds);
+}
+
+
+}
+
+
+
+int main()
+{
+    // Parse failures are counted, not logged, in a bench
+    Log->set_level(spdlog::level::info);
+    bench_render(2000);
+    bench_resize(20000, false);
+    bench_resize(20000, true);
+    bench_input(20);
+    return 0;
+}
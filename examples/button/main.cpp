@@ -1,6 +1,7 @@
 #include "consoleevent.hpp"
 #include "consolezbuffer.hpp"
 
+#include <condition_variable>
 #include <queue>
 #include <spdlog/pattern_formatter.h>
 #include <termios.h>
@@ -9,6 +10,8 @@
 #include <unistd.h>
 #include <vector>
 #include <consolewidget.hpp>
+#include <termoutput.hpp>
+#include <ringtextmap.hpp>
 #include <textmap.hpp>
 #include <coprintf.hpp>
 
@@ -25,6 +28,7 @@ public:
     ConsoleSink(Vector2u size) : ConsoleArea(size), console(size) {}
 
     void init() {
+        console.caps = TermCaps::from_env();
         termios tios;
         tcgetattr(fileno(stdin), &tios);
         tios.c_lflag &= ~ECHO & ~ICANON;
@@ -66,17 +70,45 @@ public:
         return CharUnit::none;
     }
 
+    void hint_move(Vector2u from, Vector2u to, Vector2u size) override {
+        console.hint_move(from, to, size);
+    }
+
+    void hint_scroll(Rect2u rect, int shift) override {
+        console.hint_scroll(rect, shift);
+    }
+
+    void hint_damage(Rect2u rect) override {
+        console.hint_damage(rect.clipped({{0, 0}, size}));
+    }
+
+    void write_span(unsigned row, unsigned x, const CharUnit* cells, unsigned count) override {
+        if (row < size.y and x < size.x)
+            console.write_span(row, x, cells, std::min(count, size.x - x));
+    }
+
+    void fill_rect(Rect2u rect, const CharUnit& unit) override {
+        console.fill_rect(rect.clipped({{0, 0}, size}), unit);
+    }
+
+    const CharUnit* span_data(Vector2u pos) const override {
+        return pos < size ? console.span_data(pos) : nullptr;
+    }
+
     void draw() {
         // Восстанавливаем положение для цикла
-        fwrite("\e8", 2, 1, stdout);
-        fwrite("\e7", 2, 1, stdout);
-        auto w = console.print();
-        fwrite(w.data(), w.size(), 1, stdout);
+        frame.assign("\e8\e7", 4);
+        frame = console.print_frame(std::move(frame));
+        if (frame.size() == 4)
+            return;
+        // Whatever init() left in stdio goes first, the frame is one write
         fflush(stdout);
+        write_frame(STDOUT_FILENO, frame);
     }
 
 private:
     STDIOTextArea console;
+    std::string frame;      //< Reused between frames
     Vector2u home_position;
 };
 
@@ -89,11 +121,18 @@ public:
 
     void draw(ConsoleArea* area) const override {
         // Log->trace("TextArea::draw");
+        // Lines added since the last draw scroll on the terminal too
+        auto scrolled = text_map.scroll_position() - drawn_scroll;
+        if (scrolled > 0 and scrolled < int64_t(text_map.size.y))
+            area->hint_scroll({{0, 0}, text_map.size}, int(scrolled));
+        drawn_scroll = text_map.scroll_position();
         text_map.draw(area);
     }
 
-    void add_text(const std::string& text) {
+    void add_text(std::string_view text) {
         Log->trace("TextArea::add_text '{}'", text);
+        auto first_row = cursor_pos.y;
+        bool scrolled = false;
         for (char c : text) {
             if (cursor_pos.x >= text_map.size.x) {
                 cursor_pos.x = 0;
@@ -101,34 +140,51 @@ public:
             }
             if (cursor_pos.y >= text_map.size.y) {
                 scroll_up();
+                scrolled = true;
                 cursor_pos.y = text_map.size.y - 1;
             }
             text_map.set_char(cursor_pos, CharUnit{static_cast<wchar_t>(c)});
             cursor_pos.x++;
         }
+        // Without a scroll only the rows written to changed
+        if (scrolled)
+            invalidate();
+        else
+            invalidate({{0, first_row}, {text_map.size.x, cursor_pos.y + 1 - first_row}});
+    }
+
+    void on_event(const conevent::PasteEvent& event) override {
+        // The whole paste is one add_text, one invalidate
+        add_text(event.text);
     }
 
     bool contains(Vector2u pos) const override {
         return pos < text_map.size;
     }
 
+    Vector2u view_size() const override {
+        return text_map.size;
+    }
+
+    bool opaque() const override {
+        return true;
+    }
+
+    bool rect_hit() const override {
+        return true;
+    }
+
 private:
     void scroll_up() {
         Log->trace("TextArea::scroll_up");
-        for (unsigned y = 1; y < text_map.size.y; ++y) {
-            for (unsigned x = 0; x < text_map.size.x; ++x) {
-                text_map.set_char({x, y - 1}, CharUnit{text_map.get_char({x, y})});
-            }
-        }
         // Очищаем последнюю строку после прокрутки.
-        for (unsigned x = 0; x < text_map.size.x; ++x) {
-            text_map.set_char({x, text_map.size.y - 1}, CharUnit{L' '});
-        }
+        text_map.scroll(1, CharUnit{L' '});
     }
 
 private:
-    TextMap text_map;
+    RingTextMap text_map;
     Vector2u cursor_pos{0, 0};
+    mutable int64_t drawn_scroll = 0;   //< scroll_position at the last draw
 };
 
 class Button : public ViewNotifier
@@ -205,6 +261,7 @@ public:
         textures[state] = std::move(texture);
         if (state == Normal)
             current_texture = textures[Normal].get();
+        invalidate();
     }
 
     void draw(ConsoleArea* area) const override {
@@ -220,6 +277,18 @@ public:
         return current_texture and pos < current_texture->size;
     }
 
+    Vector2u view_size() const override {
+        return current_texture ? current_texture->size : Vector2u{0, 0};
+    }
+
+    bool opaque() const override {
+        return current_texture != nullptr;
+    }
+
+    bool rect_hit() const override {
+        return true;
+    }
+
 public:
     void on_event(const conevent::MouseEnterExitEvent& event) override {
         if (event.is_enter) {
@@ -232,6 +301,7 @@ public:
             if (not button->is_pressed())
                 button->release();
         }
+        invalidate();
     }
     void on_event(const conevent::MouseButtonEvent& event) override {
         if (event.is_down) {
@@ -244,6 +314,7 @@ public:
             if (mouse_inside)
                 button->click(event.button);
         }
+        invalidate();
     }
 
 private:
@@ -260,8 +331,8 @@ public:
     class EventReceiver : public ExtendedConsoleEventReceiver
     {
     public:
-        EventReceiver(std::mutex& mutex, std::queue<AnyConsoleEvent>& queue)
-            : mutex(mutex), queue(queue) {}
+        EventReceiver(std::mutex& mutex, std::queue<AnyConsoleEvent>& queue, std::atomic<bool>& exiting)
+            : mutex(mutex), queue(queue), exiting(exiting) {}
 
     public:
         void on_any_event(AnyConsoleEvent&& ev) override
@@ -270,17 +341,36 @@ public:
             queue.push(std::move(ev));
         }
 
+        /// Handed to poll() instead of queued, the text is not copied out
+        /// of the read buffer. The reader waits until it was dispatched.
+        void on_event(const conevent::PasteEvent& event) override
+        {
+            std::unique_lock lock(mutex);
+            paste = &event;
+            handed.wait(lock, [&] { return not paste or exiting; });
+            paste = nullptr;
+        }
+
+    public:
+        const conevent::PasteEvent* paste = nullptr;   //< Waiting for poll(), guarded by the mutex
+        std::condition_variable handed;
+
     private:
         std::mutex& mutex;
         std::queue<AnyConsoleEvent>& queue;
+        std::atomic<bool>& exiting;
 
     };
 
 public:
     EventLoop()
-        : receiver(mutex, queue), sender(receiver), should_exit(false) {}
+        : receiver(mutex, queue, should_exit), sender(receiver), should_exit(false) {}
     ~EventLoop() {
-        should_exit = true;
+        {
+            std::lock_guard lg(mutex);
+            should_exit = true;
+        }
+        receiver.handed.notify_one();
         thread.join();
     }
 
@@ -289,20 +379,23 @@ private:
         fd_set fds;
         FD_ZERO(&fds);
         FD_SET(STDIN_FILENO, &fds);
+        // An ESC is only the Escape key once nothing followed it for 40 ms
+        bool pending = sender.pending();
         timeval tv;
-        tv.tv_usec = 0;
-        tv.tv_sec = 1;
-        char buffer[128];
+        tv.tv_usec = pending ? 40'000 : 0;
+        tv.tv_sec = pending ? 0 : 1;
+        char buffer[1 << 16];
         auto recl = select(1, &fds, nullptr, nullptr, &tv);
         switch(recl)
         {
-            case 0: break;
+            case 0:
+                if (pending)
+                    sender.on_idle();
+                break;
             case -1: break;
             default:
-                if (auto s = read(STDIN_FILENO, buffer, sizeof(buffer)); s > 0) {
-                    for (size_t i = 0; i < s; i++)
-                        sender.on_char(buffer[i]);
-                }
+                if (auto s = read(STDIN_FILENO, buffer, sizeof(buffer)); s > 0)
+                    sender.on_bytes({buffer, size_t(s)});
         }
     }
 
@@ -310,9 +403,19 @@ public:
     bool poll(ConsoleEventReceiver& recv) {
         AnyConsoleEvent event;
         {
-            std::lock_guard lg(mutex);
-            if (queue.empty())
-                return false;
+            std::unique_lock lock(mutex);
+            if (queue.empty()) {
+                // Everything queued came before the paste, its reader waits for us
+                auto paste = receiver.paste;
+                if (not paste)
+                    return false;
+                lock.unlock();
+                recv.on_event(*paste);
+                lock.lock();
+                receiver.paste = nullptr;
+                receiver.handed.notify_one();
+                return true;
+            }
             event = std::move(queue.front());
             queue.pop();
         }
@@ -383,6 +486,11 @@ public:
         text_area->add_text("Initial text in the text area\nSecond line");
         auto text_area_widget = std::make_shared<ConsoleViewWidget>(text_area, Vector2u{0, 5});
         zbuffer.add_view(std::move(text_area_widget));
+        focus_view = zbuffer.get_widget_at("maintext");
+
+        // Text areas and buttons only read their own maps in draw()
+        if (std::thread::hardware_concurrency() > 1)
+            zbuffer.set_thread_pool(&ThreadPool::shared());
     }
 
     void init()
@@ -433,7 +541,7 @@ private:
         auto widget = zbuffer.get_widget_at(at);
         if (event.is_down) {
             if (widget) {
-                last_pressed_view = widget;
+                last_pressed_view = focus_view = widget;
                 last_pressed_view->get_view()->on_event(event);
             }
         } else {
@@ -444,6 +552,13 @@ private:
         }
     }
 
+    void on_event(const conevent::PasteEvent& event) override
+    {
+        // Dispatched while the reader holds the text, nothing is copied
+        if (focus_view)
+            focus_view->get_view()->on_event(event);
+    }
+
 private:
     ConsoleSink console;
     ConsoleZBuffer zbuffer;
@@ -453,6 +568,7 @@ private:
 private:
     ConsoleViewWidget* last_mouse_view = nullptr;
     ConsoleViewWidget* last_pressed_view = nullptr;
+    ConsoleViewWidget* focus_view = nullptr;    //< Gets pastes, the last pressed view
 
 };
 
@@ -63,6 +63,7 @@ public:
     void load_texture(std::shared_ptr<TextMap> texture, State state) {
         Log->trace("ButtonView({})::load_texture({})", label, (int)state);
         textures[state] = std::move(texture);
+        invalidate();
     }
 
     void draw(ConsoleArea* area) const override {
@@ -77,6 +78,18 @@ public:
         return (textures[current_texture] ? pos < textures[current_texture]->size : pos.y == 0 and pos.x < 8);
     }
 
+    Vector2u view_size() const override {
+        return textures[current_texture] ? textures[current_texture]->size : Vector2u{8, 1};
+    }
+
+    bool opaque() const override {
+        return textures[current_texture] != nullptr;
+    }
+
+    bool rect_hit() const override {
+        return true;
+    }
+
     const ViewNotifier* primary_widget() const override { return button.get(); }
 
     const std::vector<std::shared_ptr<TextMap>>& get_textures() const { return textures; }
@@ -91,6 +104,7 @@ public:
             current_texture = Normal;
             mouse_inside = false;
         }
+        invalidate();
     }
     void on_event(const conevent::MouseButtonEvent& event) override {
         if (event.is_down) {
@@ -103,6 +117,7 @@ public:
             if (mouse_inside)
                 button->click(event.button);
         }
+        invalidate();
     }
 
 public:
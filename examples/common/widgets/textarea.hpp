@@ -3,6 +3,7 @@
 #include <vector>
 #include <minijson/json.h>
 #include "consolewidget.hpp"
+#include "inputscan.hpp"
 #include "textmap.hpp"
 #include "utils.hpp"
 #include "widgetregistry.hpp"
@@ -10,16 +11,6 @@
 
 
 
-inline
-std::string encode_utf8(wchar_t ch)
-{
-    if ((uint32_t)ch < 127)
-        return std::string(1, ch);
-    else
-        return "?";
-}
-
-
 class TextArea : public ViewNotifier
 {
 public:
@@ -28,16 +19,65 @@ public:
 public:
     virtual void insert_char(wchar_t ch, Vector2u pos)
     {
-        if (not editable)
-            return;
+        char32_t code = ch;
+        insert_text({&code, 1}, pos);
+    }
+
+    /// Whole run in one edit and one notify, returns the position after it
+    virtual Vector2u insert_text(std::u32string_view text, Vector2u pos)
+    {
+        if (not editable or text.empty())
+            return pos;
         if (pos.y < lines.size() and pos.x <= lines[pos.y].size()
                 or pos.y == lines.size() and pos.x == 0)
         {
             if (pos.y == lines.size())
-                lines.push_back("");
-            lines[pos.y].insert(pos.x, encode_utf8(ch));
+                lines.emplace_back();
+            lines[pos.y].insert(pos.x, text);
             this->notify();
+            pos.x += unsigned(text.size());
+        }
+        return pos;
+    }
+
+    /** paste
+     *
+     * Inserts UTF-8 text that may span lines in one edit and one notify,
+     * "\r\n", "\r" and "\n" all break lines.
+     * @return Position after the pasted text
+     */
+    virtual Vector2u paste(std::string_view text, Vector2u pos)
+    {
+        if (not editable or text.empty())
+            return pos;
+        if (not (pos.y < lines.size() and pos.x <= lines[pos.y].size()
+                 or pos.y == lines.size() and pos.x == 0))
+            return pos;
+        if (pos.y == lines.size())
+            lines.emplace_back();
+
+        // The rest of the cursor line moves behind the pasted text
+        auto tail = lines[pos.y].substr(pos.x);
+        lines[pos.y].erase(pos.x);
+
+        inputscan::Utf8Decoder utf8;
+        std::vector<std::u32string> added;
+        auto* line = &lines[pos.y];
+        while (true) {
+            auto end = text.find_first_of("\r\n");
+            utf8.decode(text.substr(0, end), *line);
+            utf8.interrupt(*line);
+            if (end == text.npos)
+                break;
+            text.remove_prefix(end + (text.substr(end, 2) == "\r\n" ? 2 : 1));
+            line = &added.emplace_back();
         }
+
+        Vector2u after{unsigned(line->size()), pos.y + unsigned(added.size())};
+        line->append(tail);
+        lines.insert(lines.begin() + pos.y + 1, std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+        this->notify();
+        return after;
     }
 
     virtual void insert_line(unsigned y)
@@ -46,7 +86,7 @@ public:
             return;
         if (y < lines.size())
         {
-            lines.insert(lines.begin() + y, std::string{""});
+            lines.insert(lines.begin() + y, std::u32string{});
             this->notify();
         }
     }
@@ -71,14 +111,19 @@ public:
     void load(std::string_view data)
     {
         clear();
-        lines.push_back("");
-        for (auto c : data) {
-            if (c == '\n')
-                lines.push_back("");
-            else if (c == '\r')
-                continue;
-            else
-                lines.emplace_back(std::string{1, c});
+        inputscan::Utf8Decoder utf8;
+        lines.emplace_back();
+        while (true) {
+            auto end = data.find('\n');
+            auto line = data.substr(0, end);
+            if (not line.empty() and line.back() == '\r')
+                line.remove_suffix(1);
+            utf8.decode(line, lines.back());
+            utf8.interrupt(lines.back());
+            if (end == data.npos)
+                break;
+            lines.emplace_back();
+            data.remove_prefix(end + 1);
         }
         this->notify();
     }
@@ -87,7 +132,7 @@ public:
     bool editable = true;
 
 private:
-    std::vector<std::string> lines;
+    std::vector<std::u32string> lines;
 
 };
 
@@ -107,6 +152,18 @@ public:
         return pos < text_map.size;
     }
 
+    Vector2u view_size() const override {
+        return text_map.size;
+    }
+
+    bool opaque() const override {
+        return true;
+    }
+
+    bool rect_hit() const override {
+        return true;
+    }
+
 public:
     void on_event(const conevent::MouseButtonEvent& event) override {
         if (event.is_down && contains(event.position)) {
@@ -117,22 +174,30 @@ public:
     void on_event(const conevent::KeyboardEvent& event) override {
         if (contains(cursor_pos)) {
             if (event.key == Key::Backspace) {
-                if (cursor_pos.x > 0) {
+                for (int i = 0; i < event.count and cursor_pos.x > 0; i++) {
                     cursor_pos.x--;
                     area->pop_char(cursor_pos);
                 }
             } else if (event.key == Key::Enter) {
-                cursor_pos.x = 0;
-                area->insert_line(cursor_pos.y);
-                cursor_pos.y++;
-            } else {
-                wchar_t ch = static_cast<wchar_t>(event.key);
-                area->insert_char(ch, cursor_pos);
-                cursor_pos.x++;
+                for (int i = 0; i < event.count; i++) {
+                    cursor_pos.x = 0;
+                    area->insert_line(cursor_pos.y);
+                    cursor_pos.y++;
+                }
             }
         }
     }
 
+    void on_event(const conevent::TextInputEvent& event) override {
+        if (contains(cursor_pos))
+            cursor_pos = area->insert_text(event.text, cursor_pos);
+    }
+
+    void on_event(const conevent::PasteEvent& event) override {
+        if (contains(cursor_pos))
+            cursor_pos = area->paste(event.text, cursor_pos);
+    }
+
 public:
     std::optional<std::string> widget_name() const
     {
@@ -155,6 +220,7 @@ public:
     void set_area_size(Vector2u size)
     {
         text_map.resize(size);
+        invalidate();
     }
 
     static constexpr auto json_properties()
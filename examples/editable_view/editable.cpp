@@ -20,7 +20,7 @@ Vector2u ConsoleSink::update_size()
     ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
     auto now = size;
     size = {w.ws_col, w.ws_row};
-    if (size != now)
+    if (not (size == now))
         console.resize(size);
     return now;
 }
@@ -54,6 +54,7 @@ private:
 };
 
 void ConsoleSink::init() {
+    console.caps = TermCaps::from_env();
     update_size();
     termios tios;
     tcgetattr(fileno(stdin), &tios);
@@ -136,6 +137,9 @@ void EditableViewApp::make_default()
         tex->set_char({(unsigned)x, 0}, std::move(ch));
     }
     btn1->load_texture(tex, ButtonView::Pressed);
+
+    if (std::thread::hardware_concurrency() > 1)
+        _buffer.set_thread_pool(&ThreadPool::shared());
 }
 
 void EditableViewApp::load_view(const std::filesystem::path& layout_path)
@@ -7,6 +7,7 @@
 #include "common/widgets/button.hpp"
 #include "consolezbuffer.hpp"
 #include "eventroot.hpp"
+#include "termoutput.hpp"
 #include "textmap.hpp"
 #include "serializable.hpp"
 #include "xtermeventloop.hpp"
@@ -43,17 +44,45 @@ public:
         return CharUnit::none;
     }
 
+    void hint_move(Vector2u from, Vector2u to, Vector2u size) override {
+        console.hint_move(from, to, size);
+    }
+
+    void hint_scroll(Rect2u rect, int shift) override {
+        console.hint_scroll(rect, shift);
+    }
+
+    void hint_damage(Rect2u rect) override {
+        console.hint_damage(rect.clipped({{0, 0}, size}));
+    }
+
+    void write_span(unsigned row, unsigned x, const CharUnit* cells, unsigned count) override {
+        if (row < size.y and x < size.x)
+            console.write_span(row, x, cells, std::min(count, size.x - x));
+    }
+
+    void fill_rect(Rect2u rect, const CharUnit& unit) override {
+        console.fill_rect(rect.clipped({{0, 0}, size}), unit);
+    }
+
+    const CharUnit* span_data(Vector2u pos) const override {
+        return pos < size ? console.span_data(pos) : nullptr;
+    }
+
     void draw() {
         // Восстанавливаем положение для цикла
-        fwrite("\e8", 2, 1, stdout);
-        fwrite("\e7", 2, 1, stdout);
-        auto w = console.print();
-        fwrite(w.data(), w.size(), 1, stdout);
+        frame.assign("\e8\e7", 4);
+        frame = console.print_frame(std::move(frame));
+        if (frame.size() == 4)
+            return;
+        // Whatever init() left in stdio goes first, the frame is one write
         fflush(stdout);
+        write_frame(STDOUT_FILENO, frame);
     }
 
 private:
     STDIOTextArea console;
+    std::string frame;      //< Reused between frames
     Vector2u home_position;
 };
 
@@ -23,6 +23,8 @@ void Client::make_default()
 {
     std::string file(json());
     _buffer = mini_json::parse<ConsoleZBuffer>(begin(file), end(file));
+    if (std::thread::hardware_concurrency() > 1)
+        _buffer.set_thread_pool(&ThreadPool::shared());
 }
 
 void Client::load_view(const std::filesystem::path& layout_path)
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include "charunit.hpp"
+
+
+
+
+/** cellkernels
+ *
+ * Frame comparison with AVX2 and SSE2 variants, picked once at run
+ * time, and a scalar fallback. Masks hold one bit per cell, 32 cells per
+ * word, set where the cells differ bytewise.
+ */
+namespace cellkernels
+{
+
+
+/// Cells compared per mask word
+inline constexpr size_t block = 32;
+
+/// Mask words for `count` cells
+inline constexpr size_t mask_words(size_t count) {
+    return (count + block - 1) / block;
+}
+
+/// Interleaved cells, `mask_words(count)` words are written
+void diff_masks(const CharUnit* a, const CharUnit* b, size_t count, uint32_t* masks);
+
+/// Same for the other cell formats, scalar
+void diff_masks(const CompactCell* a, const CompactCell* b, size_t count, uint32_t* masks);
+void diff_masks(const WideCell* a, const WideCell* b, size_t count, uint32_t* masks);
+
+/// First set bit at or after `from`, `count` when there is none
+inline size_t next_set(const uint32_t* masks, size_t from, size_t count)
+{
+    while (from < count) {
+        uint32_t word = masks[from / block] >> (from % block);
+        if (word)
+            return std::min(count, from + std::countr_zero(word));
+        from = (from / block + 1) * block;
+    }
+    return count;
+}
+
+
+}
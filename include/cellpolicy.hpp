@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "charunit.hpp"
+#include "escapewriter.hpp"
+
+
+
+
+/** GraphemeTable
+ *
+ * Interned UTF-8 clusters that do not fit a single code point, referenced
+ * by WideCell::character. The table only grows, a reference stays valid
+ * until exit.
+ */
+class GraphemeTable
+{
+public:
+    static GraphemeTable& shared();
+
+    /// Reference for `cluster`, a single code point is returned as itself
+    char32_t intern(std::string_view cluster);
+
+    /// UTF-8 bytes of a reference
+    std::string_view lookup(char32_t ref) const;
+
+private:
+    mutable std::mutex _mutex;
+    std::deque<std::string> _clusters;      //< Stable addresses for the keys below
+    std::unordered_map<std::string_view, uint32_t> _ids;
+
+};
+
+
+/*
+ * Cell policies
+ *
+ * A policy picks the cell stored by BasicTextMap and the encoder the
+ * renderer uses for it. Each one provides:
+ *
+ *   Cell, Meta                 Stored cell and its SGR state
+ *   none()                     Cell of a cleared area
+ *   from_unit(), to_unit()     Conversion at the ConsoleArea interface
+ *   blank_meta(meta, pen)      Meta a blank cell is painted with
+ *   pack(meta)                 Injective key of the SGR state
+ *   sgr_cost(), sgr()          Exact SGR transition
+ *   glyph_length(), glyph()    Printed bytes of the cell
+ *   repeatable()               REP repeats the glyph as printed
+ *
+ * is_blank, looks_same and hash_cells are overloaded for every Cell.
+ */
+
+
+/// CharUnit as it is, 8 bytes with palette colors
+struct StandardCellPolicy
+{
+    using Cell = CharUnit;
+    using Meta = CharUnit::Meta;
+
+    static constexpr size_t max_sgr_bytes = max_sgr_escape_bytes;
+
+    static const Cell& none() { return CharUnit::none; }
+    static const Cell& from_unit(const CharUnit& unit) { return unit; }
+    static const CharUnit& to_unit(const Cell& cell) { return cell; }
+
+    static Meta blank_meta(const Meta& meta, const Meta& pen) {
+        return {meta.background, pen.foreground, 0};
+    }
+
+    static uint64_t pack(const Meta& meta) {
+        return meta.background.term_color | uint64_t(meta.foreground.term_color) << 8
+                | uint64_t(meta.styles) << 16;
+    }
+
+    static unsigned sgr_cost(const Meta& next, const Meta& prev) { return sgr_escape_cost(next, prev); }
+    static void sgr(EscapeWriter& out, const Meta& next, const Meta& prev) { out.sgr(next, prev); }
+
+    static unsigned glyph_length(const Cell&) { return 1; }
+    static void glyph(EscapeWriter& out, const Cell& cell) { out.glyph(cell.character); }
+    static bool repeatable(const Cell&) { return true; }
+};
+
+
+/// CompactCell, half the memory of CharUnit for ASCII canvases
+struct CompactCellPolicy
+{
+    using Cell = CompactCell;
+    using Meta = CompactCell::Meta;
+
+    static constexpr size_t max_sgr_bytes = max_sgr_escape_bytes;
+
+    static const Cell& none() {
+        static constexpr Cell cell{'\0', {0, 15, 0}};
+        return cell;
+    }
+
+    /// Characters outside printable ASCII become '?', styles past the eighth are dropped
+    static Cell from_unit(const CharUnit& unit) {
+        char character = '?';
+        if (unit.character == L'\0' or (unit.character >= L' ' and unit.character <= (wchar_t)126))
+            character = static_cast<char>(unit.character);
+        return {character, {unit.meta.background.term_color, unit.meta.foreground.term_color,
+                            uint8_t(unit.meta.styles)}};
+    }
+
+    static CharUnit to_unit(const Cell& cell) {
+        return {wchar_t(uint8_t(cell.character)), palette_meta(cell.meta)};
+    }
+
+    static Meta blank_meta(const Meta& meta, const Meta& pen) {
+        return {meta.background, pen.foreground, 0};
+    }
+
+    static uint64_t pack(const Meta& meta) {
+        return meta.background | uint64_t(meta.foreground) << 8 | uint64_t(meta.styles) << 16;
+    }
+
+    /// Compact styles are the low bits of CharUnit styles, the palette encoder applies as is
+    static unsigned sgr_cost(const Meta& next, const Meta& prev) {
+        return sgr_escape_cost(palette_meta(next), palette_meta(prev));
+    }
+
+    static void sgr(EscapeWriter& out, const Meta& next, const Meta& prev) {
+        out.sgr(palette_meta(next), palette_meta(prev));
+    }
+
+    /// Cells hold printable ASCII or '\0' only, written without translation
+    static unsigned glyph_length(const Cell&) { return 1; }
+    static void glyph(EscapeWriter& out, const Cell& cell) {
+        out.reserve(1);
+        out.put(cell.character ? cell.character : ' ');
+    }
+    static bool repeatable(const Cell&) { return true; }
+
+private:
+    static CharUnit::Meta palette_meta(const Meta& meta) {
+        return {CharColor256Bg{meta.background}, CharColor256Fg{meta.foreground}, meta.styles};
+    }
+};
+
+
+/// WideCell, 24-bit colors and UTF-8 glyphs with grapheme references
+struct WideCellPolicy
+{
+    using Cell = WideCell;
+    using Meta = WideCell::Meta;
+
+    static constexpr size_t max_sgr_bytes = max_wide_sgr_escape_bytes;
+
+    static const Cell& none() {
+        static constexpr Cell cell{U'\0', {TrueColor::indexed(0), TrueColor::indexed(15), 0}};
+        return cell;
+    }
+
+    static Cell from_unit(const CharUnit& unit) {
+        return {char32_t(unit.character), {TrueColor::indexed(unit.meta.background.term_color),
+                                           TrueColor::indexed(unit.meta.foreground.term_color),
+                                           unit.meta.styles}};
+    }
+
+    /// 24-bit colors map to the nearest palette entry, graphemes to their first code point
+    static CharUnit to_unit(const Cell& cell);
+
+    static Meta blank_meta(const Meta& meta, const Meta& pen) {
+        return {meta.background, pen.foreground, 0};
+    }
+
+    /// Both colors are 25 bits, SGR only sees the low 12 style bits
+    static uint64_t pack(const Meta& meta) {
+        return meta.background.value | uint64_t(meta.foreground.value) << 25
+                | uint64_t(meta.styles & ascii_styles_mask) << 50;
+    }
+
+    static unsigned sgr_cost(const Meta& next, const Meta& prev) { return sgr_escape_cost(next, prev); }
+    static void sgr(EscapeWriter& out, const Meta& next, const Meta& prev) { out.sgr(next, prev); }
+
+    /// Unprintable code points print as '?'
+    static unsigned glyph_length(const Cell& cell);
+    static void glyph(EscapeWriter& out, const Cell& cell);
+
+    /// REP repeats the last code point only, not a whole cluster
+    static bool repeatable(const Cell& cell) { return not (cell.character & WideCell::grapheme_bit); }
+};
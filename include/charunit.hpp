@@ -2,121 +2,175 @@
 
 #include <cstdint>
 #include <stdexcept>
+#include <type_traits>
 #include <vector>
 #include "asciistyles.hpp"
 #include "termcolor.hpp"
 
 
-enum class EscapeSeqArgument : int
-{
-    // Usually argument in [0, 255]
-    NumberStart = 0,
-    // End of sequence
-    Eos = -1,
-    Eof = Eos,                 //< Unix-like constant :)
-    // 255 numbers is reserved
+struct CharUnit {
+    wchar_t character;               //< The character to be displayed
+    struct Meta {
+        CharColor256Bg background;   //< Background color
+        CharColor256Fg foreground;   //< Foreground color
+        uint16_t styles;             //< Bitfield representing styles, where each bit corresponds to a style ID
+    } meta;
 
-    /// Ascii symbol: [-0x1000000:-257] encoded like Escape
-    /// 0x1000000 - because utf-8
-    AsciiModStart = -0x1000000,
-    Escape = -0x1000000 + (int)'\e', //< '\e' symbol
+    static CharUnit none;
 };
 
-inline constexpr EscapeSeqArgument encode_number(int number) {
-    return static_cast<EscapeSeqArgument>(number + static_cast<int>(EscapeSeqArgument::NumberStart));
+/// Default state of console char
+inline CharUnit CharUnit::none { L'\0', CharColor256Bg{0}, CharColor256Fg{15}, 0 };
+
+// Spans of cells are copied with memcpy
+static_assert(std::is_trivially_copyable_v<CharUnit>);
+
+
+inline constexpr bool operator==(const CharUnit::Meta& left, const CharUnit::Meta& right) {
+    return left.background.term_color == right.background.term_color
+            and left.foreground.term_color == right.foreground.term_color
+            and left.styles == right.styles;
 }
 
-inline constexpr EscapeSeqArgument encode_char(wchar_t chr) {
-    return static_cast<EscapeSeqArgument>(static_cast<uint32_t>(chr) + static_cast<int>(EscapeSeqArgument::AsciiModStart));
+inline constexpr bool operator==(const CharUnit& left, const CharUnit& right) {
+    return left.character == right.character and left.meta == right.meta;
 }
 
-struct AixTermEscapeCost
-{
-    int bytes_len;
-    int arg_count;
-};
+/// Cell shows nothing but its background, foreground color is invisible
+inline constexpr bool is_blank(const CharUnit& unit) {
+    return (unit.character == L'\0' or unit.character == L' ') and unit.meta.styles == 0;
+}
 
-class EscapeSequence : public std::vector<EscapeSeqArgument>
-{
-public:
-    EscapeSequence() {}
-
-public:
-    size_t encode_all(char* buffer, size_t buf_size) const {
-        size_t pos = 0;
-        for (const auto& arg : *this) {
-            if ((int)arg == (int)EscapeSeqArgument::Eos) {
-                break;
-            }
-            if (pos >= buf_size) {
-                throw std::runtime_error("Buffer overflow while encoding escape sequence");
-            }
-
-            if ((int)arg >= (int)EscapeSeqArgument::NumberStart) {
-                // Encode numbers as ASCII digits
-                // Very slow!
-                int number = static_cast<int>(arg);
-                std::string num_str = std::to_string(number);
-                if (pos + num_str.size() >= buf_size) {
-                    throw std::runtime_error("Buffer overflow while encoding number");
-                }
-                for (char c : num_str) {
-                    buffer[pos++] = c;
-                }
-            } else if ((int)arg > (int)EscapeSeqArgument::AsciiModStart
-                       && (int)arg < -256) { //< arg is negative, -2..-256 is reserved
-                // Encode ASCII character
-                wchar_t chr = static_cast<wchar_t>((int)arg - (int)EscapeSeqArgument::AsciiModStart);
-                if (chr <= 0x7F) {
-                    buffer[pos++] = static_cast<char>(chr); // ASCII character
-                } else {
-                    throw std::runtime_error("Unsupported character encoding");
-                }
-            } else {
-                throw std::runtime_error("Unsupported escape sequence argument");
-            }
-        }
-        return pos;
-    }
-};
+/// Both cells look the same on the terminal
+inline constexpr bool looks_same(const CharUnit& left, const CharUnit& right) {
+    return left == right
+            or (is_blank(left) and is_blank(right)
+                and left.meta.background.term_color == right.meta.background.term_color);
+}
 
-struct CharUnit {
-    wchar_t character;               //< The character to be displayed
+/// 64-bit key of the visible state, blank cells map to one key per background
+inline constexpr uint64_t cell_hash_key(const CharUnit& unit) {
+    uint64_t background = uint64_t(unit.meta.background.term_color) << 32;
+    uint64_t full = uint64_t(uint32_t(unit.character)) | background
+            | uint64_t(unit.meta.foreground.term_color) << 40
+            | uint64_t(unit.meta.styles) << 48;
+    // Branchless select keeps hash_cells vectorizable
+    uint64_t mask = uint64_t(0) - uint64_t(is_blank(unit));
+    return (full & ~mask) | ((uint64_t(L' ') | background) & mask);
+}
+
+/// Hash of cells as the terminal shows them, equal for looks_same sequences
+uint64_t hash_cells(const CharUnit* cells, size_t count);
+
+
+/** CompactCell
+ *
+ * 4-byte cell for huge canvases: a printable ASCII byte, palette indexes
+ * and the first eight styles.
+ */
+struct CompactCell {
+    char character;
     struct Meta {
-        CharColor256Bg background;   //< Background color
-        CharColor256Fg foreground;   //< Foreground color
-        uint16_t styles;             //< Bitfield representing styles, where each bit corresponds to a style ID
+        uint8_t background;
+        uint8_t foreground;
+        uint8_t styles;
     } meta;
+};
 
-    static CharUnit none;
+static_assert(sizeof(CompactCell) == 4 and std::is_trivially_copyable_v<CompactCell>);
+
+
+inline constexpr bool operator==(const CompactCell::Meta& left, const CompactCell::Meta& right) {
+    return left.background == right.background and left.foreground == right.foreground
+            and left.styles == right.styles;
+}
+
+inline constexpr bool operator==(const CompactCell& left, const CompactCell& right) {
+    return left.character == right.character and left.meta == right.meta;
+}
+
+inline constexpr bool is_blank(const CompactCell& unit) {
+    return (unit.character == '\0' or unit.character == ' ') and unit.meta.styles == 0;
+}
+
+inline constexpr bool looks_same(const CompactCell& left, const CompactCell& right) {
+    return left == right
+            or (is_blank(left) and is_blank(right) and left.meta.background == right.meta.background);
+}
+
+inline constexpr uint64_t cell_hash_key(const CompactCell& unit) {
+    uint64_t background = uint64_t(unit.meta.background) << 8;
+    uint64_t full = uint64_t(uint8_t(unit.character)) | background
+            | uint64_t(unit.meta.foreground) << 16 | uint64_t(unit.meta.styles) << 24;
+    uint64_t mask = uint64_t(0) - uint64_t(is_blank(unit));
+    return (full & ~mask) | ((uint64_t(' ') | background) & mask);
+}
+
+uint64_t hash_cells(const CompactCell* cells, size_t count);
+
+
+/** WideCell
+ *
+ * 16-byte cell with 24-bit colors. `character` is a code point, or a
+ * GraphemeTable reference when `grapheme_bit` is set.
+ */
+struct WideCell {
+    static constexpr char32_t grapheme_bit = char32_t(1) << 31;
+
+    char32_t character;
+    struct Meta {
+        TrueColor background;
+        TrueColor foreground;
+        uint32_t styles;
+    } meta;
 };
 
-/// Default state of console char
-inline CharUnit CharUnit::none { L'\0', CharColor256Bg{0}, CharColor256Fg{15}, 0 };
+static_assert(sizeof(WideCell) == 16 and std::is_trivially_copyable_v<WideCell>);
 
 
-inline constexpr EscapeSeqArgument encode_color_4bit(CharColor256Fg color) {
-    if (color.term_color < 8)
-        return encode_number(static_cast<int>(AsciiStyleCode::Foregrount4StartLower) + color.term_color);
-    else
-        return encode_number(static_cast<int>(AsciiStyleCode::Foregrount4StartUpper) + color.term_color - 8);
+inline constexpr bool operator==(const WideCell::Meta& left, const WideCell::Meta& right) {
+    return left.background == right.background and left.foreground == right.foreground
+            and left.styles == right.styles;
 }
 
+inline constexpr bool operator==(const WideCell& left, const WideCell& right) {
+    return left.character == right.character and left.meta == right.meta;
+}
 
-inline constexpr EscapeSeqArgument encode_color_4bit(CharColor256Bg color) {
-    if (color.term_color < 8)
-        return encode_number(static_cast<int>(AsciiStyleCode::Background4StartLower) + color.term_color);
-    else
-        return encode_number(static_cast<int>(AsciiStyleCode::Background4StartUpper) + color.term_color - 8);
+inline constexpr bool is_blank(const WideCell& unit) {
+    return (unit.character == U'\0' or unit.character == U' ') and unit.meta.styles == 0;
 }
 
+inline constexpr bool looks_same(const WideCell& left, const WideCell& right) {
+    return left == right
+            or (is_blank(left) and is_blank(right) and left.meta.background == right.meta.background);
+}
+
+/// Both halves of the cell folded into one key, blank cells keep one key per background
+inline constexpr uint64_t cell_hash_key(const WideCell& unit) {
+    uint64_t background = uint64_t(unit.meta.background.value) << 32;
+    uint64_t high = (uint64_t(unit.meta.foreground.value) | uint64_t(unit.meta.styles) << 32)
+            * 0x9E3779B97F4A7C15ull;
+    uint64_t full = (uint64_t(unit.character) | background) ^ high;
+    uint64_t mask = uint64_t(0) - uint64_t(is_blank(unit));
+    return (full & ~mask) | ((uint64_t(U' ') | background) & mask);
+}
+
+uint64_t hash_cells(const WideCell* cells, size_t count);
+
+
+class EscapeWriter;
 
 /** to_aixterm_escape
  *
- * @param[out] sequence Output sequence
+ * @param[out] out      Output writer
  * @param[in]  unit     Unit to encode
  * @param[in]  prev     Prev unit
  */
-void to_aixterm_escape(EscapeSequence& sequence, const CharUnit& unit, const CharUnit& prev = CharUnit::none);
+void to_aixterm_escape(EscapeWriter& out, const CharUnit& unit, const CharUnit& prev = CharUnit::none);
 
-AixTermEscapeCost aixterm_escape_cost(const CharUnit& unit, const CharUnit& prev = CharUnit::none, bool fast = false);
+/** aixterm_escape_cost
+ *
+ * @return  Exact bytes to_aixterm_escape writes for the same arguments
+ */
+unsigned aixterm_escape_cost(const CharUnit& unit, const CharUnit& prev = CharUnit::none);
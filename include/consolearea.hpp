@@ -26,18 +26,69 @@ public:
     virtual const CharUnit& get_char(Vector2u pos) const = 0;
 
     virtual void clear() {
-        for (unsigned y = 0; y < size.y; y++)
-            for (unsigned x = 0; x < size.x; x++)
-                set_char({x, y}, CharUnit{CharUnit::none});
+        fill_rect({{0, 0}, size}, CharUnit::none);
+    }
+
+    /// Cells of a `size` rectangle at `from` were redrawn at `to`, renderers may copy them
+    virtual void hint_move(Vector2u /*from*/, Vector2u /*to*/, Vector2u /*size*/) {}
+
+    /// Rows of `rect` were scrolled up by `shift`, down when negative, renderers may scroll them
+    virtual void hint_scroll(Rect2u /*rect*/, int /*shift*/) {}
+
+    /// Cells of `rect` were written. Renderers may look at damaged rows
+    /// only, writes through the area damage their rows on their own.
+    virtual void hint_damage(Rect2u /*rect*/) {}
+
+public:
+    // Bulk primitives, clipped once per call. The defaults fall back to
+    // set_char, areas with row storage override them with row copies.
+
+    /// `count` cells to row `row` starting at column `x`
+    virtual void write_span(unsigned row, unsigned x, const CharUnit* cells, unsigned count) {
+        if (row >= size.y or x >= size.x)
+            return;
+        count = std::min(count, size.x - x);
+        for (unsigned i = 0; i < count; i++)
+            set_char({x + i, row}, CharUnit{cells[i]});
+    }
+
+    virtual void fill_rect(Rect2u rect, const CharUnit& unit) {
+        rect = rect.clipped({{0, 0}, size});
+        for (unsigned y = rect.position.y; y < rect.end().y; y++)
+            for (unsigned x = rect.position.x; x < rect.end().x; x++)
+                set_char({x, y}, CharUnit{unit});
+    }
+
+    /// Contiguous cells of row `pos.y` from column `pos.x`, nullptr without row storage
+    virtual const CharUnit* span_data(Vector2u /*pos*/) const {
+        return nullptr;
+    }
+
+    /// Copies `src_rect` of `src` to `dst_pos`, one write_span per row
+    void blit(const ConsoleArea& src, Rect2u src_rect, Vector2u dst_pos) {
+        src_rect = src_rect.clipped({{0, 0}, src.size});
+        if (src_rect.empty() or dst_pos.x >= size.x or dst_pos.y >= size.y)
+            return;
+        unsigned width = std::min(src_rect.size.x, size.x - dst_pos.x);
+        unsigned height = std::min(src_rect.size.y, size.y - dst_pos.y);
+        std::vector<CharUnit> row;
+        for (unsigned y = 0; y < height; y++) {
+            Vector2u from{src_rect.position.x, src_rect.position.y + y};
+            const CharUnit* cells = src.span_data(from);
+            if (not cells) {
+                row.resize(width);
+                for (unsigned x = 0; x < width; x++)
+                    row[x] = src.get_char({from.x + x, from.y});
+                cells = row.data();
+            }
+            write_span(dst_pos.y + y, dst_pos.x, cells, width);
+        }
     }
 
 public:
     void draw(ConsoleArea* area) const
     {
-        for (unsigned y = 0; y < std::min<unsigned>(area->size.y, size.y); y++)
-            for (unsigned x = 0; x < std::min<unsigned>(area->size.x, size.x); x++)
-                area->set_char({x, y}, CharUnit{get_char({x, y})});
-        constexpr auto j = sizeof(area);
+        area->blit(*this, {{0, 0}, size}, {0, 0});
     }
 
     void f(int ff) {}
@@ -52,20 +103,33 @@ void draw(ConsoleArea* area, Vector2u pos, std::string const& str, CharUnit::Met
 {
     if (pos.x >= area->size.x or pos.y >= area->size.y)
         return;
-    unsigned y = pos.y, x = pos.x, xs = area->size.x - pos.x;
+    // Lines go out as spans in chunks of a small stack buffer
+    CharUnit chunk[64];
+    unsigned count = 0;
+    unsigned y = pos.y, x = pos.x, start = pos.x, xs = area->size.x - pos.x;
+    auto flush = [&] {
+        area->write_span(y, start, chunk, count);
+        start += count;
+        count = 0;
+    };
     for (auto c : str)
     {
         if (x >= xs or c == '\n') {
+            flush();
             y = y + 1;
-            x = pos.x;
+            x = start = pos.x;
             if (c == '\n')
                 continue;
         }
         if (y >= area->size.y)
             break;
-        area->set_char({x, y}, {c, styles});
+        if (count == std::size(chunk))
+            flush();
+        chunk[count++] = {c, styles};
         ++x;
     }
+    if (y < area->size.y)
+        flush();
 }
 
 
@@ -3,9 +3,12 @@
 #include "consolearea.hpp"
 #include <cstdint>
 #include <map>
+#include <span>
+#include <variant>
 
 #include "consoleevent_t.hpp"
 #include "escapeparsehelper.hpp"
+#include "inputscan.hpp"
 
 
 
@@ -15,6 +18,15 @@ class ConsoleEventSender
 {
 public:
     virtual bool on_char(char chr) = 0;
+
+    /// Whole read at once, byte by byte unless the sender knows better
+    virtual void on_bytes(std::span<const char> bytes) {
+        for (char chr : bytes)
+            on_char(chr);
+    }
+
+    /// Input went quiet for a while, nothing more is coming for now
+    virtual void on_idle() {}
 };
 
 
@@ -27,13 +39,32 @@ public:
     virtual void on_event(const conevent::MouseButtonEvent&) {}
     virtual void on_event(const conevent::MouseMoveEvent&) {}
     virtual void on_event(const conevent::KeyboardEvent&) {}
+    virtual void on_event(const conevent::TextInputEvent&) {}
+    virtual void on_event(const conevent::PasteEvent&) {}
     virtual void on_event(const conevent::XTermStatusEvent&) {}
     virtual void on_event(const conevent::XTermDSRPositionEvent&) {}
 };
 
 
 
-using AnyConsoleEvent = std::variant<conevent::FocusEvent, conevent::MouseEnterExitEvent, conevent::MouseButtonEvent, conevent::MouseMoveEvent, conevent::KeyboardEvent, conevent::XTermStatusEvent, conevent::XTermDSRPositionEvent>;
+/// TextInputEvent owning its text, for events kept past the call
+struct OwnedTextInputEvent
+{
+    std::u32string text;
+
+    operator conevent::TextInputEvent() const { return {text}; }
+};
+
+/// PasteEvent owning its text, likewise
+struct OwnedPasteEvent
+{
+    std::string text;
+
+    operator conevent::PasteEvent() const { return {text}; }
+};
+
+
+using AnyConsoleEvent = std::variant<conevent::FocusEvent, conevent::MouseEnterExitEvent, conevent::MouseButtonEvent, conevent::MouseMoveEvent, conevent::KeyboardEvent, OwnedTextInputEvent, OwnedPasteEvent, conevent::XTermStatusEvent, conevent::XTermDSRPositionEvent>;
 
 class ExtendedConsoleEventReceiver : public ConsoleEventReceiver
 {
@@ -53,6 +84,12 @@ public:
     void on_event(const conevent::KeyboardEvent& event) override {
         on_any_event({event});
     }
+    void on_event(const conevent::TextInputEvent& event) override {
+        on_any_event(OwnedTextInputEvent{std::u32string(event.text)});
+    }
+    void on_event(const conevent::PasteEvent& event) override {
+        on_any_event(OwnedPasteEvent{std::string(event.text)});
+    }
     void on_event(const conevent::XTermStatusEvent& event) override {
         on_any_event({event});
     }
@@ -75,21 +112,41 @@ public:
 
 public:
     void init() {
-        printf("\e[?1000;1003;1006;1015h");
+        printf("\e[?1000;1003;1006;1015;2004h");
     }
 
 public:
     bool on_char(char chr) override
     {
-        try
-        {
-            _parse_context.next(chr);
-            return true;
-        }
-        catch (const std::runtime_error& e) {
-            Log->error("Runtime error: \"{}\", stack: \"{}\"", e.what(), escape_string(_parse_context.stack()));
-            return false;
+        // Inside a sequence only ESC, a lone ESC and bytes that break it
+        // need more than the parser
+        if (not _parse_context.idle() and not _pasting and chr != '\e' and _parse_context.pending() != "\e") {
+            auto status = parse(chr);
+            if (status == escparse::ParseStatus::Ignored)
+                return feed({&chr, 1});
+            if (status == escparse::ParseStatus::Unconsumed) {
+                feed({&chr, 1});
+                return false;
+            }
+            return status != escparse::ParseStatus::Error;
         }
+        return feed({&chr, 1});
+    }
+
+    /// Runs of text go out whole, the parser only sees sequences
+    void on_bytes(std::span<const char> bytes) override;
+
+    /// An ESC nothing followed is the Escape key rather than a split sequence
+    void on_idle() override;
+
+    /// A sequence is in progress, on_idle() after a quiet spell settles it
+    bool pending() const noexcept {
+        return not _parse_context.idle();
+    }
+
+    /// Sequences parsed, broken, turned down and bytes no rule starts
+    const escparse::ParseContext::Stats& parse_stats() const noexcept {
+        return _parse_context.stats();
     }
 
 private:
@@ -100,15 +157,38 @@ private:
         if (idx == 3)
             return MouseButton::Unspecified;
         if (btn & 0x80)
-            throw std::runtime_error("Not supported MB6, MB7");
-            // return (MouseButton)((int)MouseButton::MB6 + idx);
+            return idx < 2 ? (MouseButton)((int)MouseButton::MB6 + idx) : MouseButton::Unspecified;
         if (btn & 0x40)
             return (MouseButton)((int)MouseButton::MB4 + idx);
         return (MouseButton)((int)MouseButton::MB1 + idx);
     };
 
+private:
+    /// False when a byte broke a sequence or a handler rejected it
+    bool feed(std::span<const char> bytes);
+    escparse::ParseStatus parse(char chr)
+    {
+        // Only receivers throw, unmatched bytes and unknown keys are counted
+        try {
+            return _parse_context.next(chr);
+        }
+        catch (const std::runtime_error& e) {
+            Log->error("Runtime error: \"{}\"", e.what());
+            if (Log->should_log(spdlog::level::debug))
+                Log->debug("stack: \"{}\"", escape_string(_parse_context.stack()));
+            return escparse::ParseStatus::Error;
+        }
+    }
+    void text(std::span<const char> bytes);
+    /// Keyboard event for a C0 control or DEL, `count` times in a row
+    void control(char chr, int count);
+    /// Bytes of a bracketed paste up to its end marker, returns those consumed
+    size_t paste(std::span<const char> bytes);
+
 private:
     void xterm_arrow(int count, char chr);
+    void xterm_key(char chr);
+    void xterm_alt(char chr);
     void xterm_status(int status);
     void xterm_fn_key(int key);
     void xterm_btn_urxvt_M(int btn, int x, int y);
@@ -123,5 +203,10 @@ private:
     escparse::ParseContext _parse_context;
     Vector2u _last_mouse_pos{0, 0};
     conevent::CtrlStatus _mouse_status;
+    inputscan::Utf8Decoder _utf8;
+    std::u32string _text;           //< Decoded run, reused
+    bool _pasting = false;
+    std::string _paste;             //< Paste split across reads, reused
+    size_t _paste_match = 0;        //< Bytes of the end marker the last read ended with
 
 };
@@ -2,6 +2,7 @@
 
 #include "utils.hpp"
 #include "kbevent.hpp"
+#include <string_view>
 
 
 
@@ -98,10 +99,25 @@ struct KeyboardEvent
 {
     Key key;
     int count = 1;
+    CtrlStatus status = CtrlStatus::None;
     uint64_t bam[2];
 };
 
 
+/// Run of typed text, the view is only valid during the call
+struct TextInputEvent
+{
+    std::u32string_view text;   //< Code points, no control characters
+};
+
+
+/// Bracketed paste, the view is only valid during the call
+struct PasteEvent
+{
+    std::string_view text;      //< UTF-8 as the terminal sent it, line breaks included
+};
+
+
 // ---------------------- --------------- -----------------------
 
 
@@ -1,8 +1,9 @@
 #ifndef CONSOLEWIDGET_HPP
 #define CONSOLEWIDGET_HPP
 
-#include <vector>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "consolearea.hpp"
 #include "consoleevent.hpp"
@@ -20,18 +21,50 @@ public:
 
 public:
     void set_char(Vector2u pos,
-                  CharUnit&& ch)
+                  CharUnit&& ch) override
     {
         if (pos < size)
             view->set_char(pos + position, std::move(ch));
     }
-    CharUnit const& get_char(Vector2u pos) const
+    CharUnit const& get_char(Vector2u pos) const override
     {
         if (pos < size)
             return view->get_char(pos + position);
         else
             return CharUnit::none;
     }
+    void hint_move(Vector2u from, Vector2u to, Vector2u size) override
+    {
+        view->hint_move(from + position, to + position, size);
+    }
+    void hint_scroll(Rect2u rect, int shift) override
+    {
+        rect = rect.clipped({{0, 0}, size});
+        if (not rect.empty())
+            view->hint_scroll({rect.position + position, rect.size}, shift);
+    }
+    void hint_damage(Rect2u rect) override
+    {
+        rect = rect.clipped({{0, 0}, size});
+        if (not rect.empty())
+            view->hint_damage({rect.position + position, rect.size});
+    }
+
+    void write_span(unsigned row, unsigned x, const CharUnit* cells, unsigned count) override
+    {
+        if (row < size.y and x < size.x)
+            view->write_span(row + position.y, x + position.x, cells, std::min(count, size.x - x));
+    }
+    void fill_rect(Rect2u rect, const CharUnit& unit) override
+    {
+        rect = rect.clipped({{0, 0}, size});
+        if (not rect.empty())
+            view->fill_rect({rect.position + position, rect.size}, unit);
+    }
+    const CharUnit* span_data(Vector2u pos) const override
+    {
+        return pos < size ? view->span_data(pos + position) : nullptr;
+    }
 
 public:
     ConsoleArea* const view;
@@ -56,14 +89,39 @@ public:
 public:
     virtual void draw(ConsoleArea* area) const = 0;
     virtual void notify(const ViewNotifier* notifier) {}
+    /// Cells that take clicks, within view_size when there is one. The pick
+    /// plane samples it on composite, call invalidate() when it changes.
     virtual bool contains(Vector2u pos) const = 0;
     virtual const ViewNotifier* primary_widget() const { return nullptr; }
+    /// Extent of what draw() paints, zero when unknown
+    virtual Vector2u view_size() const { return {0, 0}; }
+    /// draw() paints every cell of view_size, nothing below shows through
+    virtual bool opaque() const { return false; }
+    /// contains() takes every cell of view_size and nothing else, the pick
+    /// plane then fills the rect instead of sampling contains() cell by cell
+    virtual bool rect_hit() const { return false; }
+
+    /// Bumped whenever draw() may paint something else. A notifier firing
+    /// bumps it, views changing on their own call invalidate() themselves.
+    uint64_t revision() const noexcept { return _revision; }
+    void invalidate() noexcept { invalidate(whole); }
+    /// Only `rect` of the view changed, in view coordinates
+    void invalidate(Rect2u rect) noexcept { _damage = _damage.united(rect); ++_revision; }
+    /// Rect invalidated since the last call, empty when none
+    Rect2u take_damage() noexcept { return std::exchange(_damage, Rect2u{}); }
+
+    /// Every cell of any view
+    static inline const Rect2u whole{{0, 0}, {~0u, ~0u}};
 
 public:
     std::string label;
 
 protected:
     bool mouse_inside = false;
+
+private:
+    uint64_t _revision = 0;
+    Rect2u _damage{};
 };
 
 
@@ -89,10 +147,16 @@ public:
 public:
     // Methods
     void notify() {
+        notify(ConsoleView::whole);
+    }
+
+    /// Only `rect` of the views changed, in view coordinates
+    void notify(Rect2u rect) {
         // Log->trace("ViewNotifier::notify called");
         for (const auto& weak_view : view_ptrs) {
             if (auto view = weak_view.lock()) {
                 // Log->trace("ViewNotifier::notify - valid view, performing update");
+                view->invalidate(rect);
                 view->notify(this); // Replace nullptr with actual ConsoleArea if needed
             }
         }
@@ -1,6 +1,90 @@
 #pragma once
 
+#include <optional>
 #include "consolewidget.hpp"
+#include "textmap.hpp"
+#include "threadpool.hpp"
+
+
+
+/** ViewLayer
+ *
+ * Cached rendering of one view, owned by ConsoleZBuffer. The view draws
+ * into it only when its revision, the view itself or its size changed;
+ * otherwise the z-buffer composites the cells kept from the last draw.
+ * Cells the draw wrote are marked, the others stay transparent as they
+ * would with a live draw. Hints given while drawing are held until the
+ * frame sends them.
+ */
+class ViewLayer : public TextMap
+{
+public:
+    ViewLayer() : TextMap(Vector2u{0, 0}) {}
+
+public:
+    void set_char(Vector2u pos, CharUnit&& ch) override {
+        TextMap::set_char(pos, std::move(ch));
+        mark({pos, {1, 1}});
+    }
+    void write_span(unsigned row, unsigned x, const CharUnit* cells, unsigned count) override {
+        TextMap::write_span(row, x, cells, count);
+        mark({{x, row}, {count, 1}});
+    }
+    void fill_rect(Rect2u rect, const CharUnit& unit) override {
+        TextMap::fill_rect(rect, unit);
+        mark(rect);
+    }
+    void hint_move(Vector2u from, Vector2u to, Vector2u size) override {
+        moves.push_back({from, to, size});
+    }
+    void hint_scroll(Rect2u rect, int shift) override {
+        scrolls.push_back({rect, shift});
+    }
+
+    /// Blank `size` cells with nothing written, ready for a draw
+    void reset(Vector2u size) {
+        resize(size);
+        // Cleared past the override, blanks are not written cells
+        TextMap::fill_rect({{0, 0}, size}, CharUnit::none);
+        _written.assign(size_t(size.x) * size.y, 0);
+    }
+
+    /// Calls `visit(from, to)` for every run [from, to) of written cells in row `y`
+    template<typename Visit>
+    void for_each_written(unsigned y, Visit&& visit) const {
+        const uint8_t* row = &_written[size_t(y) * size.x];
+        for (unsigned x = 0; x < size.x; ) {
+            while (x < size.x and not row[x])
+                x++;
+            unsigned from = x;
+            while (x < size.x and row[x])
+                x++;
+            if (from < x)
+                visit(from, x);
+        }
+    }
+
+public:
+    const ConsoleView* view = nullptr;  //< Drawn view, nullptr when the layer is stale
+    uint64_t revision = 0;              //< ConsoleView::revision of the draw
+    std::optional<Rect2u> footprint;    //< Area cells of the last composite, nullopt for live views
+    bool highlighted = false;           //< Highlight of the last composite
+    Rect2u cells;                       //< Area cells of the view, without the highlight
+    bool hidden = false;                //< Covered by opaque views this frame
+    std::optional<Rect2u> changed;      //< take_changes of this frame
+    std::vector<ViewMove> moves;
+    std::vector<ViewScroll> scrolls;
+
+private:
+    void mark(Rect2u rect) {
+        rect = rect.clipped({{0, 0}, size});
+        for (unsigned y = rect.position.y; y < rect.end().y; y++)
+            std::fill_n(&_written[size_t(y) * size.x + rect.position.x], rect.size.x, 1);
+    }
+
+private:
+    std::vector<uint8_t> _written;      //< One per cell, set once the draw wrote it
+};
 
 
 
@@ -20,11 +104,34 @@ public:
     void set_view(std::shared_ptr<ConsoleView>&& view) { this->view = std::move(view); notify(); }
     void draw(ConsoleArea* area) const;
     void set_highlighted(bool v = true) { highlighted = v; }
+    bool is_highlighted() const noexcept { return highlighted; }
+
+public:
+    // Layered drawing used by ConsoleZBuffer
+
+    /// Cells of `area` the widget paints, nullopt when the view has no view_size
+    std::optional<Rect2u> footprint(Vector2u area) const;
+
+    /// Part of the view changed since `layer` was drawn, in view coordinates, nullopt when it is current
+    std::optional<Rect2u> take_changes(const ViewLayer& layer) const;
+
+    /// Draws the view into `layer`, touches nothing else of the widget
+    void render_layer(ViewLayer& layer) const;
+
+    /// Sends the move of the widget and the hints held by `layer`
+    void send_hints(ConsoleArea* area, ViewLayer& layer) const;
+
+    /// Copies the written cells of `layer` to the widget position, writes outside a clipping area are dropped
+    void composite(ConsoleArea* area, const ViewLayer& layer) const;
+
+private:
+    void draw_highlight(ConsoleArea* rect) const;
 
 private:
     std::shared_ptr<ConsoleView> view;
     Vector2u position;
     bool highlighted;
+    mutable std::optional<Vector2u> drawn_position;    //< Position of the last draw
 };
 
 
@@ -44,15 +151,48 @@ public:
     void add_view(std::shared_ptr<ConsoleViewWidget>&& view);
     void notify(const ViewNotifier* notifier) override;
 
-    // Draw method to draw all views
+    /** draw
+     *
+     * Recomposites only the cells damaged since the last draw into the same
+     * area: moved or resized widgets and the rects their views invalidated.
+     * Another area, a new area size or a view without view_size repaints
+     * everything. The damage is reported with ConsoleArea::hint_damage.
+     * Cells under opaque views are not composited, views they cover
+     * completely are not even drawn.
+     */
     void draw(ConsoleArea* area) const override;
+    /// Top widget of a cell as last drawn, from the pick plane when every view has a view_size
     ConsoleViewWidget* get_widget_at(Vector2u position);
     ConsoleViewWidget* get_widget_at(std::string_view name);
     bool contains(Vector2u pos) const override;
 
     const std::vector<std::shared_ptr<ConsoleViewWidget>>& get_views() const;
 
+    /** set_thread_pool
+     *
+     * Stale layers are drawn on `pool`, nullptr draws them on the calling
+     * thread. The draw() of every view must then be safe to run concurrently
+     * with the others: a draw that reads only its own view and writes only
+     * the area it gets is. Blits of TextMap and RingTextMap and ::draw of a
+     * string are, so are the text areas and buttons of the examples. Views
+     * sharing mutable state, or sharing a map of another cell policy, whose
+     * get_char converts into one scratch unit per map, are not.
+     */
+    void set_thread_pool(ThreadPool* pool) { this->pool = pool; }
+
 private:
     std::vector<std::shared_ptr<ConsoleViewWidget>> views;
+    mutable std::vector<ViewLayer> layers;     //< One per view, same order
+
+    void add_damage(Rect2u rect) const;
+
+    mutable std::vector<Rect2u> damage;        //< Disjoint rects of the frame being drawn
+    mutable std::vector<Rect2u> occluders;     //< Cells of each opaque view, empty for others
+    mutable std::vector<uint32_t> pick;        //< Index + 1 of the top view of each drawn cell
+    mutable bool live = false;                 //< Some view had no view_size in the last draw
+    mutable std::vector<size_t> stale;         //< Views whose layer is redrawn this frame
+    ThreadPool* pool = nullptr;
+    mutable const ConsoleArea* drawn_area = nullptr;
+    mutable Vector2u drawn_size{0, 0};
 
 };
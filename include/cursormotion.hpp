@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include "charunit.hpp"
+#include "utils.hpp"
+
+
+class EscapeWriter;
+
+
+/// Column or row the renderer can't vouch for (frame start, pending wrap)
+inline constexpr unsigned cursor_unknown = ~0u;
+
+
+/** CursorMotion
+ *
+ * Cheapest byte sequence moving the cursor between two cells. A move is a
+ * vertical part followed by a horizontal part, both picked by exact byte
+ * cost, or a single CUP when that is shorter.
+ */
+struct CursorMotion
+{
+    enum class Vertical : uint8_t
+    {
+        None,
+        Up,         //< CUU "\e[nA"
+        Down,       //< CUD "\e[nB"
+        Row,        //< VPA "\e[nd"
+        Newline,    //< CR + LF * n, column becomes 0
+    };
+
+    enum class Horizontal : uint8_t
+    {
+        None,
+        Forward,    //< CUF "\e[nC"
+        Backward,   //< CUB "\e[nD"
+        Backspace,  //< BS * n
+        Column,     //< HPA "\e[nG"
+        Return,     //< CR, column becomes 0
+        ReturnForward, //< CR + CUF, from an unknown column
+        Reprint,    //< Caller re-emits the cells in between
+    };
+
+    bool absolute = false;          //< CUP "\e[y;xH"
+    Vertical vertical = Vertical::None;
+    Horizontal horizontal = Horizontal::None;
+    unsigned cost = 0;
+
+    /** plan
+     *
+     * @param[in] from     Current cursor, x or both may be cursor_unknown
+     * @param[in] to       Target cell
+     * @param[in] reprint  Bytes to re-emit cells [from.x, to.x) of the row,
+     *                     cursor_unknown if that is not possible
+     */
+    static CursorMotion plan(Vector2u from, Vector2u to, unsigned reprint = cursor_unknown);
+
+    /// Writes the planned sequence, Horizontal::Reprint writes nothing
+    void emit(EscapeWriter& out, Vector2u from, Vector2u to) const;
+
+    /// Bytes emit writes, `cost` also counts the CR the tty adds to each LF
+    unsigned length(Vector2u from, Vector2u to) const {
+        if (horizontal == Horizontal::Reprint)
+            return 0;
+        if (not absolute and vertical == Vertical::Newline)
+            return cost - (to.y - from.y);
+        return cost;
+    }
+};
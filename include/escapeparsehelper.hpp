@@ -2,10 +2,12 @@
 
 #include "consolearea.hpp"
 #include "utils.hpp"
+#include <array>
+#include <cstring>
 #include <functional>
 #include <typeinfo>
 #include <memory>
-#include <variant>
+#include <string_view>
 #include <vector>
 
 
@@ -20,40 +22,36 @@ namespace escparse
 
 
 class BaseRule;
-using ArgSupport = std::variant<int, std::string>;
 class ParseContext;
 class BaseFinalFunction;
-using ParseResult = std::variant<const BaseFinalFunction*, const BaseRule*>;
 
 
+/** BaseFinalFunction
+ * Handler of a sequence, called through a plain function pointer rather
+ * than a virtual: the thunk FinalFunction sets up unpacks the slots and
+ * calls the member of the handler object directly.
+ */
 class BaseFinalFunction
 {
 public:
     BaseFinalFunction(BaseFinalFunction&&) = default;
     BaseFinalFunction &operator=(BaseFinalFunction&&) = default;
 
-public:
-    BaseFinalFunction() {}
-    virtual ~BaseFinalFunction() {}
-
-public:
-    virtual void call(std::vector<ArgSupport>& args) const = 0;
-
-};
-
+protected:
+    using Thunk = void (*)(const BaseFinalFunction& self, const int* args);
 
-class BaseRuleContext
-{
-public:
-    BaseRuleContext(BaseRuleContext&&) = default;
-    BaseRuleContext &operator=(BaseRuleContext&&) = default;
+    BaseFinalFunction(size_t arity) : _arity(arity) {}
 
 public:
-    BaseRuleContext() {}
-    virtual ~BaseRuleContext() {}
+    /// Arguments read from the slots by call()
+    size_t arity() const noexcept { return _arity; }
+    void call(const int* args) const { _thunk(*this, args); }
 
-public:
-    virtual void addArgument(ParseContext& ctx) = 0;
+protected:
+    Thunk _thunk = nullptr;
+    void* _obj = nullptr;                       //< Handler object of a member final
+    alignas(void*) unsigned char _member[2 * sizeof(void*)];  //< Its member pointer, typed again by the thunk
+    size_t _arity;
 
 };
 
@@ -65,6 +63,15 @@ enum class RuleType
 };
 
 
+/// Value a container rule adds to the arguments of its finals
+enum class RuleArgument : uint8_t
+{
+    None,       //< Only matches its byte
+    Int,        //< Decimal number, repeats while can_parse
+    Char        //< The matched byte
+};
+
+
 class BaseRule
 {
 public:
@@ -99,10 +106,7 @@ public:
     RuleType type() const noexcept final { return RuleType::Container; }
 
     virtual std::string chr() const = 0;
-
-public:
-    virtual std::unique_ptr<BaseRuleContext> make_context() const = 0;
-    virtual bool next(BaseRuleContext* ctx, char chr) const = 0;
+    virtual RuleArgument argument() const noexcept = 0;
 
 public:
     virtual const std::vector<const BaseRule*>& child_rules() const = 0;
@@ -134,156 +138,130 @@ public:
 // --------------------------------- --- ---------------------------------
 
 
+/// What ParseContext::next did with a byte
+enum class ParseStatus : uint8_t
+{
+    Pending,        //< Consumed, the sequence goes on
+    Dispatched,     //< Completed a sequence and called its final
+    Ignored,        //< Starts no rule, left to the caller
+    Error,          //< Broke the sequence, the parser resynchronizes
+    Unconsumed      //< Broke the sequence and is left to the caller
+};
+
+
+/** ParseContext
+ *
+ * The rule tree compiled into a flat table with a row of 256 steps for every
+ * state. A step names the next state and what the byte does to the argument
+ * slots, entering a state that owns a final calls it with the slots and
+ * returns to the ground state. Parsing does not allocate, the tree is only
+ * kept for the finals and diagnostics.
+ *
+ * A byte no rule expects is an error, never an exception. The rest of the
+ * broken sequence is dropped up to its final byte (0x40-0x7E). Controls,
+ * DEL and bytes from 0x80 on are input of their own and no part of a
+ * sequence, the one that breaks it is not consumed and goes back to the
+ * caller along with the ESC that starts over.
+ */
 class ParseContext
 {
 public:
-    ParseContext(const BaseContainerRule* root)
-        : _root(root)
-    {
-        _current = _root;
-    }
+    static constexpr size_t max_arguments = 8;
+    static constexpr size_t max_stack = 64;
 
-public:
-    void next(char chr)
+    struct Stats
     {
-        if (_invalid_stack) {
-            _stack.clear();
-            _invalid_stack = false;
-        }
-        _stack.push_back(chr);
-        if (_context and _current->next(_context.get(), chr))
-            ;
-        else if (not _context and _current->can_parse(chr))
-        {
-            enter(_current);
-        }
-        else if (not _context)
-        {
-            _invalid_stack = true;
-            throw std::runtime_error("_context == nullptr. Root escape rule corrupted?");
-        }
-        else {
-            _context->addArgument(*this);
-            auto& childs = _current->child_rules();
-            for (auto child : childs) {
-                if (not child->pop_char())
-                    throw std::runtime_error("Internal error (no pop char reached)");
-                if (child->can_parse(chr)) {
-                    enter(child);
-                    _current->next(_context.get(), chr);
-                    return;
-                }
-            }
-            std::string avail;
-            for (auto child : childs) {
-                auto info = (child->type() == RuleType::Container
-                             ? dynamic_cast<const BaseContainerRule*>(child)->chr()
-                             : dynamic_cast<const BaseFinalRule*>(child)->info());
-                avail += info + ", ";
-            }
-            if (not avail.empty())
-                avail.erase(avail.end() - 2, avail.end());
-            _current = _root;
-            _context = {};
-            _invalid_stack = true;
-            throw std::runtime_error("Can't find rule by chr '" + escape_string(std::string_view(&chr, 1)) + "', available: " + avail + ". skip.");
-        }
-    }
+        uint64_t sequences = 0;
+        uint64_t errors = 0;
+        uint64_t ignored = 0;
+        uint64_t rejected = 0;
+    };
 
-    const std::string& stack() const {
-        return _stack;
-    }
+public:
+    explicit ParseContext(const BaseContainerRule* root);
 
 public:
-    template<typename Arg>
-    void addArgument(Arg&& arg)
-    {
-        _args.emplace_back(std::forward<Arg>(arg));
-    }
+    ParseStatus next(char chr);
 
-private:
-    void enter(const BaseRule* base)
-    {
-        if (base->type() == RuleType::Container) {
-            auto current = static_cast<const BaseContainerRule*>(base);
-            _current = current;
-            _context = current->make_context();
-            bool found = false;
-            for (auto& child : current->child_rules()) {
-                if (found)
-                    throw std::runtime_error("Invalid rule, double no pop char");
-                if (not child->pop_char()) {
-                    enter(child);
-                    found = true;
-                    continue;
-                }
-            }
-        }
-        else {
-            auto current = static_cast<const BaseFinalRule*>(base);
-            current->get_final()->call(_args);
-            _args.clear();
-            _invalid_stack = true;
-            Log->trace("ParseContext::enter Stack invalid '{}'", escape_string(_stack));
-            _context = {};
-            _current = _root;
-        }
-    }
+    /// In the ground state, the next byte starts a new sequence
+    bool idle() const noexcept { return _state == 0 and not _discard; }
 
-private:
-    const BaseContainerRule* _root;
-    const BaseContainerRule* _current;
-    std::unique_ptr<BaseRuleContext> _context;
-    std::vector<ArgSupport> _args;
-    std::string _stack;
-    bool _invalid_stack = true;
+    /// Bytes of the sequence in progress
+    std::string_view pending() const {
+        return _invalid_stack ? std::string_view{} : stack();
+    }
 
-};
+    /// Drops the sequence in progress
+    void reset() noexcept {
+        _state = 0;
+        _discard = false;
+        _invalid_stack = true;
+    }
 
+    /// For a final that turns down the sequence it was called for
+    void reject() noexcept { ++_stats.rejected; }
 
-// ------------------------------- Helpers -------------------------------
+    const Stats& stats() const noexcept { return _stats; }
+    void reset_stats() noexcept { _stats = {}; }
 
+    /// Bytes of the current sequence, truncated to max_stack
+    std::string_view stack() const {
+        return {_stack.data(), _stack_len};
+    }
 
-template<typename RuleContext>
-class BaseRuleHelper : public BaseContainerRule
-{
-public:
-    std::unique_ptr<BaseRuleContext> make_context() const override
+private:
+    enum class Op : uint8_t
     {
-        return std::make_unique<RuleContext>();
-    }
+        Fail,
+        Skip,
+        Start,      //< First digit of an Int slot
+        Digit,
+        Byte
+    };
 
-    virtual bool next(RuleContext* ctx, char chr) const = 0;
-    bool next(BaseRuleContext* ctx, char chr) const override final
+    struct Step
     {
-        return next(static_cast<RuleContext*>(ctx), chr);
-    }
+        uint16_t state = 0;
+        Op op = Op::Fail;
+        uint8_t slot = 0;
+    };
 
-};
+    struct State
+    {
+        const BaseContainerRule* rule;      //< nullptr for the ground and final states
+        const BaseFinalFunction* final;     //< Called on entering
+    };
 
+    /// Adds the state of a rule whose arguments fill `slots` and its subtree
+    uint16_t compile(const BaseContainerRule* rule, size_t slots);
+    uint16_t add_state(const BaseContainerRule* rule, const BaseFinalFunction* final, size_t slots);
+    /// Links the bytes that start `rule` from `state`, compiling its subtree
+    void enter(uint16_t state, const BaseContainerRule* rule, size_t slots);
+    /// Routes the bytes `rule` accepts that are still free in `state` to `target`
+    void link(uint16_t state, const BaseRule* rule, uint16_t target, Op op, size_t slot);
+    Step& step(uint16_t state, char chr) {
+        return _steps[size_t(state) * 256 + uint8_t(chr)];
+    }
 
+    ParseStatus fail(char chr);
+    /// Debug log of the rules that would have matched
+    void log_failure(const BaseContainerRule* rule, char chr) const;
 
-template<typename T>
-class SimpleContext : public BaseRuleContext
-{
-public:
-    void addArgument(ParseContext& ctx) override
-    {
-        ctx.addArgument(value);
-    }
+private:
+    std::vector<State> _states;         //< Ground state first
+    std::vector<Step> _steps;
+    std::array<int, max_arguments> _args{};
+    uint16_t _state = 0;
+    std::array<char, max_stack> _stack{};
+    size_t _stack_len = 0;
+    bool _invalid_stack = true;
+    bool _discard = false;      //< Dropping the tail of a broken sequence
+    Stats _stats;
 
-public:
-    T value = {};
 };
 
 
-
-template<>
-class SimpleContext<void> : public BaseRuleContext
-{
-public:
-    void addArgument(ParseContext& ctx) override {}
-};
+// ------------------------------- Helpers -------------------------------
 
 
 template<typename Root>
@@ -316,32 +294,49 @@ public:
     FinalFunction(FinalFunction&&) = default;
     FinalFunction& operator=(FinalFunction&&) = default;
     FinalFunction(std::function<void(Args&&...)> func)
-        : _func(func) {}
+        : BaseFinalFunction(sizeof...(Args)), _func(std::move(func))
+    {
+        _thunk = &call_function;
+    }
+    template<typename Functor, typename... Args_>
+    FinalFunction(Functor* fn, void (Functor::* mem)(Args_...))
+        : BaseFinalFunction(sizeof...(Args))
+    {
+        static_assert(sizeof(mem) <= sizeof(_member), "member pointer does not fit");
+        _thunk = &call_member<Functor, Args_...>;
+        _obj = fn;
+        std::memcpy(_member, &mem, sizeof(mem));
+    }
 
 private:
-    template<typename T>
-    static T get(ArgSupport& arg) {
-        if constexpr (std::is_convertible_v<int, T>)
-            return std::forward<T>(std::get<int>(arg));
-        else if constexpr (std::is_convertible_v<std::string, T>)
-            return std::forward<T>(std::get<std::string>(arg));
-        else
-            throw std::runtime_error("Error can't select type");
-    };
-
-public:
-    void call(std::vector<ArgSupport>& args) const override
+    template<typename F>
+    static void unpack(const int* args, F&& func)
     {
         using Tuple = std::tuple<Args...>;
         auto call = [&]<size_t... index>(std::index_sequence<index...> seq) {
-            _func(get<typename std::tuple_element<index, Tuple>::type>(args.at(index))...);
+            func(static_cast<typename std::tuple_element<index, Tuple>::type>(args[index])...);
         };
         constexpr auto seq = std::make_index_sequence<sizeof...(Args)>();
         call(seq);
     }
 
+    static void call_function(const BaseFinalFunction& self, const int* args)
+    {
+        unpack(args, static_cast<const FinalFunction&>(self)._func);
+    }
+
+    template<typename Functor, typename... Args_>
+    static void call_member(const BaseFinalFunction& self, const int* args)
+    {
+        auto& final = static_cast<const FinalFunction&>(self);
+        void (Functor::* mem)(Args_...);
+        std::memcpy(&mem, final._member, sizeof(mem));
+        auto fn = static_cast<Functor*>(final._obj);
+        unpack(args, [fn, mem](Args&&... args) { (fn->*mem)(std::forward<Args>(args)...); });
+    }
+
 private:
-    std::function<void(Args&&...)> _func;
+    std::function<void(Args&&...)> _func;   //< Lambda finals only
 
 };
 
@@ -351,23 +346,23 @@ class FinalRule final : public BaseFinalRule
 {
 public:
     FinalRule(char chr, std::function<void(Args&&...)>&& func = {}, const char* info = nullptr)
-        : _func(func),
-          _chr(chr),
+        : _chr(chr),
+          _func(func),
           _info(info ? info + std::string(typeid(void(*)(Args...)).name()) : "<unknown>" + std::string(typeid(void(*)(Args...)).name())) {}
     FinalRule(CS_NoPopChar, std::function<void(Args&&...)>&& func = {}, const char* info = nullptr)
-        : _func(func),
-          _chr('\0'),
+        : _chr('\0'),
+          _func(func),
           _info(info ? info + std::string(typeid(void(*)(Args...)).name()) : "<unknown>" + std::string(typeid(void(*)(Args...)).name())) {}
 
     template<typename Functor, typename... Args_>
     FinalRule(char chr, Functor* fn, void (Functor::* mem)(Args_...), const char* info = nullptr)
-        : _func([fn, mem](Args&&... args) { (fn->*mem)(std::forward<Args_>(args)...); }),
-          _chr(chr),
+        : _chr(chr),
+          _func(fn, mem),
           _info(info ? std::string(info) + ": " + typeid(fn->*mem).name() : typeid(fn->*mem).name()) {}
     template<typename Functor, typename... Args_>
     FinalRule(CS_NoPopChar, Functor* fn, void (Functor::* mem)(Args_...), const char* info = nullptr)
-        : _func([fn, mem](Args&&... args) { (fn->*mem)(std::forward<Args_>(args)...); }),
-          _chr('\0'),
+        : _chr('\0'),
+          _func(fn, mem),
           _info(info ? std::string(info) + ": " + typeid(fn->*mem).name() : typeid(fn->*mem).name()) {}
 
 public:
@@ -383,7 +378,7 @@ public:
 
     bool can_parse(char chr) const override
     {
-        return _chr == '\0' and _chr == chr;
+        return _chr != '\0' and _chr == chr;
     }
 
     const char* info() const override
@@ -392,10 +387,10 @@ public:
     }
 
 public:
-    template<typename Functor, typename... Args_>
+    template<typename Functor>
     FinalRule& operator()(Functor* fn, void (Functor::* mem)(Args...)) &
     {
-        _func = [fn, mem](Args&&... args) { (fn->*mem)(std::forward<Args_>(args)...); };
+        _func = FinalFunction<Args...>(fn, mem);
         return (FinalRule&)*this;
     }
 
@@ -486,7 +481,7 @@ private:
 
 
 
-class TParseInt : public BaseRuleHelper<SimpleContext<int>>
+class TParseInt : public BaseContainerRule
 {
 public:
     TParseInt(TParseInt&&) = default;
@@ -500,14 +495,7 @@ public:
         return '0' <= chr && chr <= '9';
     }
 
-    bool next(SimpleContext<int>* ctx, char chr) const override
-    {
-        if (not can_parse(chr))
-            return false;
-        ctx->value *= 10;
-        ctx->value += chr - '0';
-        return true;
-    }
+    RuleArgument argument() const noexcept override { return RuleArgument::Int; }
 
     std::string chr() const override { return "<int>"; }
 
@@ -515,7 +503,7 @@ public:
 
 
 
-class TSkipChar : public BaseRuleHelper<SimpleContext<void>>
+class TSkipChar : public BaseContainerRule
 {
 public:
     TSkipChar(TSkipChar&&) = default;
@@ -529,10 +517,7 @@ public:
         return chr == _char;
     }
 
-    bool next(SimpleContext<void>* ctx, char chr) const override
-    {
-        return false;
-    }
+    RuleArgument argument() const noexcept override { return RuleArgument::None; }
 
     std::string chr() const override { return escape_string({&_char, 1}); }
 
@@ -543,7 +528,7 @@ private:
 
 
 
-class TParseChar : public BaseRuleHelper<SimpleContext<uint8_t>>
+class TParseChar : public BaseContainerRule
 {
 public:
     TParseChar(TParseChar&&) = default;
@@ -559,11 +544,7 @@ public:
         return not _pred or _pred(chr);
     }
 
-    bool next(SimpleContext<uint8_t>* ctx, char chr) const override
-    {
-        ctx->value = chr;
-        return false;
-    }
+    RuleArgument argument() const noexcept override { return RuleArgument::Char; }
 
     std::string chr() const override { return _info; }
 
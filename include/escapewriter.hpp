@@ -0,0 +1,258 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "asciistyles.hpp"
+#include "charunit.hpp"
+
+
+
+
+/// Text of a short escape parameter, filled at compile time
+struct EscapeFragment
+{
+    uint8_t len;
+    char text[11];
+
+    constexpr void append(const char* str) {
+        while (*str)
+            text[len++] = *str++;
+    }
+
+    constexpr void append(unsigned number) {
+        char digits[10];
+        int count = 0;
+        do {
+            digits[count++] = char('0' + number % 10);
+            number /= 10;
+        } while (number);
+        while (count)
+            text[len++] = digits[--count];
+    }
+};
+
+
+/// Decimal text of every numeric parameter in [0, 255]
+inline constexpr auto escape_numbers = [] {
+    std::array<EscapeFragment, 256> table{};
+    for (unsigned i = 0; i < table.size(); i++)
+        table[i].append(i);
+    return table;
+}();
+
+
+/// Byte length of a numeric parameter
+inline constexpr unsigned escape_number_len(unsigned number) {
+    if (number < escape_numbers.size())
+        return escape_numbers[number].len;
+    unsigned len = 0;
+    for (; number; number /= 10)
+        len++;
+    return len;
+}
+
+
+/// Bytes of "\e[nX" where the parameter is omitted for 1
+inline constexpr unsigned escape_csi_cost(unsigned n) {
+    return 3 + (n == 1 ? 0 : escape_number_len(n));
+}
+
+
+/// SGR parameters for every foreground color: "3x", "9x" or "38;5;x"
+inline constexpr auto escape_foregrounds = [] {
+    std::array<EscapeFragment, 256> table{};
+    for (unsigned i = 0; i < table.size(); i++) {
+        if (i < 8)
+            table[i].append(static_cast<unsigned>(AsciiStyleCode::Foregrount4StartLower) + i);
+        else if (i < 16)
+            table[i].append(static_cast<unsigned>(AsciiStyleCode::Foregrount4StartUpper) + i - 8);
+        else {
+            table[i].append(static_cast<unsigned>(AsciiStyleCode::Foreground8Or24));
+            table[i].append(";5;");
+            table[i].append(i);
+        }
+    }
+    return table;
+}();
+
+
+/// SGR parameters for every background color: "4x", "10x" or "48;5;x"
+inline constexpr auto escape_backgrounds = [] {
+    std::array<EscapeFragment, 256> table{};
+    for (unsigned i = 0; i < table.size(); i++) {
+        if (i < 8)
+            table[i].append(static_cast<unsigned>(AsciiStyleCode::Background4StartLower) + i);
+        else if (i < 16)
+            table[i].append(static_cast<unsigned>(AsciiStyleCode::Background4StartUpper) + i - 8);
+        else {
+            table[i].append(static_cast<unsigned>(AsciiStyleCode::Background8Or24));
+            table[i].append(";5;");
+            table[i].append(i);
+        }
+    }
+    return table;
+}();
+
+
+inline constexpr size_t ascii_styles_count = sizeof(ascii_styles) / sizeof(ascii_styles[0]);
+inline constexpr uint16_t ascii_styles_mask = (1 << ascii_styles_count) - 1;
+
+/// Styles switched off together by the disable code of each style
+/// (e.g. "22" turns off both bold and faint)
+inline constexpr auto ascii_styles_cleared = [] {
+    std::array<uint16_t, ascii_styles_count> table{};
+    for (size_t i = 0; i < ascii_styles_count; i++)
+        for (size_t j = 0; j < ascii_styles_count; j++)
+            if (ascii_styles[i].disable == ascii_styles[j].disable)
+                table[i] |= uint16_t(1 << j);
+    return table;
+}();
+
+
+/// Longest SGR transition: reset, every style and both 8-bit colors
+inline constexpr size_t max_sgr_escape_bytes = 2 + 2 + ascii_styles_count * 3 + 9 + 9;
+/// Same with two 24-bit colors, "38;2;255;255;255;"
+inline constexpr size_t max_wide_sgr_escape_bytes = 2 + 2 + ascii_styles_count * 3 + 17 + 17;
+/// CUP with two 10-digit coordinates
+inline constexpr size_t max_jump_escape_bytes = 2 + 10 + 1 + 10 + 1;
+
+
+/// Exact bytes EscapeWriter::sgr(next, prev) writes, 0 when nothing changes
+unsigned sgr_escape_cost(const CharUnit::Meta& next, const CharUnit::Meta& prev);
+unsigned sgr_escape_cost(const WideCell::Meta& next, const WideCell::Meta& prev);
+
+
+/// Bytes of a code point in UTF-8
+inline constexpr unsigned utf8_length(char32_t code) {
+    return code < 0x80 ? 1 : code < 0x800 ? 2 : code < 0x10000 ? 3 : 4;
+}
+
+
+/** EscapeWriter
+ *
+ * Writes final escape bytes straight into the tail of a string in one pass.
+ * Every primitive reserves its worst case itself, `finish()` trims the
+ * string to the written length.
+ */
+class EscapeWriter
+{
+public:
+    explicit EscapeWriter(std::string& out)
+        : _out(out), _len(out.size()) {}
+    ~EscapeWriter() { finish(); }
+
+    EscapeWriter(const EscapeWriter&) = delete;
+    EscapeWriter& operator=(const EscapeWriter&) = delete;
+
+public:
+    void reserve(size_t bytes) {
+        if (_len + bytes > _out.size())
+            _out.resize(std::max(_out.size() * 2, _len + bytes));
+    }
+
+    void finish() {
+        _out.resize(_len);
+    }
+
+    size_t size() const noexcept {
+        return _len;
+    }
+
+    const char* data() const noexcept {
+        return _out.data();
+    }
+
+    /// Last written byte
+    char& back() {
+        return _out[_len - 1];
+    }
+
+public:
+    /// Unchecked writes, caller must reserve
+    void put(char chr) {
+        _out[_len++] = chr;
+    }
+
+    void put(const char* str, size_t len) {
+        std::memcpy(_out.data() + _len, str, len);
+        _len += len;
+    }
+
+    void put(const EscapeFragment& frag) {
+        put(frag.text, frag.len);
+    }
+
+    void put_number(unsigned number) {
+        if (number < escape_numbers.size())
+            return put(escape_numbers[number]);
+        EscapeFragment frag{};
+        frag.append(number);
+        put(frag);
+    }
+
+public:
+    /// "\e[0m", terminal pen becomes CharUnit::none.meta
+    void reset() {
+        reserve(4);
+        put("\e[0m", 4);
+    }
+
+    /// CUP to zero-based (x, y), default parameters are omitted
+    void jump(unsigned x, unsigned y) {
+        reserve(max_jump_escape_bytes);
+        put("\e[", 2);
+        if (x != 0) {
+            put_number(y + 1);
+            put(';');
+            put_number(x + 1);
+        }
+        else if (y != 0)
+            put_number(y + 1);
+        put('H');
+    }
+
+    /// "\e[nX" where the parameter is omitted for 1
+    void csi(unsigned n, char final) {
+        reserve(max_jump_escape_bytes);
+        put("\e[", 2);
+        if (n != 1)
+            put_number(n);
+        put(final);
+    }
+
+    /// "\e[a;bX" with both parameters written
+    void csi(unsigned a, unsigned b, char final) {
+        reserve(max_jump_escape_bytes);
+        put("\e[", 2);
+        put_number(a);
+        put(';');
+        put_number(b);
+        put(final);
+    }
+
+    /// Single SGR switching the terminal pen from `prev` to `next`
+    void sgr(const CharUnit::Meta& next, const CharUnit::Meta& prev);
+    /// Same for 24-bit colors, "38;2;r;g;b" where the color is not a palette index
+    void sgr(const WideCell::Meta& next, const WideCell::Meta& prev);
+
+    /// Printable byte for the cell glyph
+    void glyph(wchar_t chr) {
+        reserve(1);
+        if (chr == L'\0')
+            put(' ');
+        else if (chr < L' ' or chr > (wchar_t)126)
+            put('?');
+        else
+            put(static_cast<char>(chr));
+    }
+
+    /// UTF-8 bytes of a valid code point
+    void utf8(char32_t code);
+
+private:
+    std::string& _out;
+    size_t _len;
+
+};
@@ -46,6 +46,16 @@ public:
             _focus_view->on_event(event);
     }
 
+    void on_event(const conevent::TextInputEvent& event) override {
+        if (_focus_view)
+            _focus_view->on_event(event);
+    }
+
+    void on_event(const conevent::PasteEvent& event) override {
+        if (_focus_view)
+            _focus_view->on_event(event);
+    }
+
 
 private:
     ConsoleZBuffer& _buffer;
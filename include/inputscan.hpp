@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+
+
+/** inputscan
+ *
+ * Byte scans over terminal input with AVX2 and SSE2 variants, picked once
+ * at run time like the cell kernels, and a scalar fallback.
+ */
+namespace inputscan
+{
+
+
+/// Length of the prefix free of C0 controls (ESC among them) and DEL
+size_t text_run(const char* bytes, size_t count);
+
+/// Length of the prefix below 0x80
+size_t ascii_run(const char* bytes, size_t count);
+
+
+/** Utf8Decoder
+ *
+ * Code points of UTF-8 text that may be split across reads. Malformed,
+ * overlong and surrogate sequences become U+FFFD.
+ */
+class Utf8Decoder
+{
+public:
+    /// Appends the code points `bytes` complete
+    void decode(std::string_view bytes, std::u32string& out);
+    /// Ends a partial code point cut off by a control byte
+    void interrupt(std::u32string& out);
+
+private:
+    char32_t _code = 0;
+    char32_t _min = 0;      //< Smallest code point for the length, anything below is overlong
+    uint8_t _need = 0;      //< Continuation bytes still missing
+
+};
+
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include "termcaps.hpp"
+#include "textmap.hpp"
+
+
+class EscapeWriter;
+
+
+/** ScrollMotion
+ *
+ * Vertical shift of a screen rectangle between two frames. It is sent as
+ * DECSTBM (plus DECSLRM for partial rows) with SU/SD, or as a DL/IL pair
+ * for whole rows, so only the exposed rows have to be painted.
+ */
+struct ScrollMotion
+{
+    enum class Method : uint8_t
+    {
+        Region,         //< "\e[t;br" + SU/SD + "\e[r"
+        InsertDelete,   //< DL at one edge, IL at the other
+    };
+
+    unsigned top = 0, bottom = 0;   //< Rows [top, bottom) of the scroll region
+    unsigned left = 0, right = 0;   //< Columns [left, right)
+    int shift = 0;                  //< Rows moved up when positive, down when negative
+    Method method = Method::Region;
+
+    explicit operator bool() const { return shift != 0; }
+
+    /** plan
+     *
+     * Matches rows of both frames by row hash, like the ncurses hashmap,
+     * and picks the shift that saves the most repainted rows. Call it
+     * again after `apply` to find the next moved hunk.
+     *
+     * @param[in] back   New frame
+     * @param[in] front  Frame the terminal shows
+     * @return    Empty motion when nothing is worth moving
+     */
+    template<typename Policy>
+    static ScrollMotion plan(const BasicTextMap<Policy>& back, const BasicTextMap<Policy>& front,
+                             const TermCaps& caps);
+
+    /** plan
+     *
+     * Takes a reported scroll as it is, clipped to the screen, when the
+     * rows it fixes outweigh its cost. Rows written after the scroll are
+     * painted as usual.
+     */
+    template<typename Policy>
+    static ScrollMotion plan(const BasicTextMap<Policy>& back, const BasicTextMap<Policy>& front,
+                             const ViewScroll& hint, const TermCaps& caps);
+
+    /// Bytes emit writes
+    unsigned length(Vector2u size) const;
+
+    /// Writes the sequence, margins are left reset
+    void emit(EscapeWriter& out, Vector2u size) const;
+
+    /// Cursor after emit
+    Vector2u cursor(Vector2u size) const;
+
+    /// Applies the shift to the frame, exposed cells become `blank`
+    template<typename Policy>
+    void apply(BasicTextMap<Policy>& frame, const typename Policy::Cell& blank) const;
+};
+
+
+/** RectCopy
+ *
+ * DECCRA copy of a moved view from its old position to the new one, so
+ * only the exposed strip has to be painted.
+ */
+struct RectCopy
+{
+    Vector2u from, to, size;
+
+    explicit operator bool() const { return size.x != 0 and size.y != 0; }
+
+    /** plan
+     *
+     * Clips the hinted move to the screen and keeps it when the copied
+     * cells fix more than the copy costs.
+     *
+     * @return  Empty copy otherwise
+     */
+    template<typename Policy>
+    static RectCopy plan(const BasicTextMap<Policy>& back, const BasicTextMap<Policy>& front,
+                         const ViewMove& hint, const TermCaps& caps);
+
+    /// Bytes emit writes
+    unsigned length() const;
+
+    /// "\e[t;l;b;r;;t;l$v", the cursor does not move
+    void emit(EscapeWriter& out) const;
+
+    /// Applies the copy to the frame
+    template<typename Policy>
+    void apply(BasicTextMap<Policy>& frame) const;
+};
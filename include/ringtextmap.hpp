@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "cellpolicy.hpp"
+#include "consolearea.hpp"
+
+
+
+
+/** BasicRingTextMap
+ *
+ * Text map whose rows live in a ring buffer: scrolling rotates the first
+ * row and clears the exposed ones, so a log pane pays for the new rows
+ * only. The cell format follows the policy, as in BasicTextMap.
+ */
+template<typename Policy>
+class BasicRingTextMap : public ConsoleArea
+{
+public:
+    using Cell = typename Policy::Cell;
+
+    BasicRingTextMap(Vector2u size = {0, 0})
+        : ConsoleArea(size), _map(size.x * size.y, Policy::none()) {}
+
+    void set_char(Vector2u pos, CharUnit&& ch) override
+    {
+        if (pos < size)
+            row(pos.y)[pos.x] = Policy::from_unit(ch);
+    }
+
+    /// Other formats are converted into a scratch unit, valid until the next get_char
+    CharUnit const& get_char(Vector2u pos) const override
+    {
+        if (not (pos < size))
+            return CharUnit::none;
+        if constexpr (std::is_same_v<Cell, CharUnit>)
+            return row_data(pos.y)[pos.x];
+        else
+            return _unit = Policy::to_unit(row_data(pos.y)[pos.x]);
+    }
+
+    void write_span(unsigned row, unsigned x, const CharUnit* cells, unsigned count) override;
+    void fill_rect(Rect2u rect, const CharUnit& unit) override;
+
+    const CharUnit* span_data(Vector2u pos) const override
+    {
+        if constexpr (std::is_same_v<Cell, CharUnit>)
+            return pos < size ? row_data(pos.y) + pos.x : nullptr;
+        else
+            return nullptr;
+    }
+
+public:
+    /// Cells of row `y`, `size.x` of them
+    const Cell* row_data(unsigned y) const { return &_map[ring_row(y) * size.x]; }
+
+    /** scroll
+     *
+     * Moves every row up by `count`, down when negative, and fills the
+     * exposed rows with `blank`. Costs the exposed rows only.
+     */
+    void scroll(int count, const Cell& blank = Policy::none());
+
+    /// Rows scrolled up since construction, down scrolls subtract. Views
+    /// compare it between draws to report ConsoleArea::hint_scroll.
+    int64_t scroll_position() const noexcept { return _scrolled; }
+
+    void resize(Vector2u size);
+
+private:
+    unsigned ring_row(unsigned y) const {
+        y += _first;
+        return y < size.y ? y : y - size.y;
+    }
+
+    Cell* row(unsigned y) { return &_map[ring_row(y) * size.x]; }
+
+private:
+    std::vector<Cell> _map;
+    unsigned _first = 0;        //< Storage row shown as row 0
+    int64_t _scrolled = 0;
+    mutable CharUnit _unit{};   //< get_char result of converted formats
+
+};
+
+
+using RingTextMap = BasicRingTextMap<StandardCellPolicy>;
+using CompactRingTextMap = BasicRingTextMap<CompactCellPolicy>;
+using WideRingTextMap = BasicRingTextMap<WideCellPolicy>;
+
+// Defined in ringtextmap.cpp for the policies above
+extern template class BasicRingTextMap<StandardCellPolicy>;
+extern template class BasicRingTextMap<CompactCellPolicy>;
+extern template class BasicRingTextMap<WideCellPolicy>;
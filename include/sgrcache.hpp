@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "cellpolicy.hpp"
+#include "escapewriter.hpp"
+
+
+
+
+/** BasicSgrTransitionCache
+ *
+ * Direct-mapped cache of encoded SGR transitions keyed by the (prev, next)
+ * pair of Policy::Meta. A screen uses a handful of distinct metas, so
+ * after the first frame nearly every transition is a copy of a few bytes.
+ */
+template<typename Policy>
+class BasicSgrTransitionCache
+{
+public:
+    using Meta = typename Policy::Meta;
+
+    static constexpr size_t capacity = 256;
+
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+public:
+    /// Same bytes as Policy::sgr(out, next, prev)
+    void encode(EscapeWriter& out, const Meta& next, const Meta& prev)
+    {
+        if (next == prev)
+            return;
+        auto key = make_key(next, prev);
+        auto& entry = slot(key);
+        if (entry.key == key) {
+            ++_stats.hits;
+            out.reserve(entry.len);
+            out.put(entry.bytes, entry.len);
+            return;
+        }
+        ++_stats.misses;
+        auto start = out.size();
+        Policy::sgr(out, next, prev);
+        entry.key = key;
+        entry.len = static_cast<uint8_t>(out.size() - start);
+        std::memcpy(entry.bytes, out.data() + start, entry.len);
+    }
+
+    /// Same value as Policy::sgr_cost(next, prev), free for cached transitions
+    unsigned cost(const Meta& next, const Meta& prev) const
+    {
+        if (next == prev)
+            return 0;
+        auto key = make_key(next, prev);
+        auto& entry = slot(key);
+        if (entry.key == key)
+            return entry.len;
+        return Policy::sgr_cost(next, prev);
+    }
+
+    const Stats& stats() const noexcept { return _stats; }
+    void reset_stats() noexcept { _stats = {}; }
+
+private:
+    static constexpr unsigned index_bits = 8;
+    static_assert(capacity == 1 << index_bits);
+
+    /// Packed metas, equal halves only occur for transitions that write nothing
+    struct Key
+    {
+        uint64_t prev = 0;
+        uint64_t next = 0;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    static Key make_key(const Meta& next, const Meta& prev) {
+        return {Policy::pack(prev), Policy::pack(next)};
+    }
+
+    struct Entry
+    {
+        Key key;            //< Empty slots hold an equal pair with len 0, which is right for it
+        uint8_t len = 0;
+        char bytes[Policy::max_sgr_bytes];
+    };
+
+    static size_t index(const Key& key) {
+        return ((key.prev * 0x9E3779B97F4A7C15ull) ^ key.next) * 0xBF58476D1CE4E5B9ull >> (64 - index_bits);
+    }
+
+    Entry& slot(const Key& key) { return _entries[index(key)]; }
+    const Entry& slot(const Key& key) const { return _entries[index(key)]; }
+
+private:
+    std::array<Entry, capacity> _entries;
+    Stats _stats;
+
+};
+
+
+using SgrTransitionCache = BasicSgrTransitionCache<StandardCellPolicy>;
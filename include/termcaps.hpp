@@ -0,0 +1,24 @@
+#pragma once
+
+
+
+
+/** TermCaps
+ *
+ * Optional sequences the renderer may use. Erase sequences assume the
+ * terminal fills erased cells with the current background (bce).
+ */
+struct TermCaps
+{
+    bool repeat = false;        //< REP "\e[nb", repeat the last glyph
+    bool erase_chars = true;    //< ECH "\e[nX"
+    bool erase_line = true;     //< EL "\e[K"
+    bool scroll_region = true;  //< DECSTBM "\e[t;br" with SU/SD "\e[nS"/"\e[nT"
+    bool insert_delete_line = true; //< IL "\e[nL" and DL "\e[nM"
+    bool sync_output = true;    //< "\e[?2026h" .. "\e[?2026l" around a frame, ignored where unknown
+    bool rect_copy = false;     //< DECCRA "\e[t;l;b;r;;t;l$v", VT420 and later only
+    bool lr_margins = false;    //< DECLRMM "\e[?69h" with DECSLRM "\e[l;rs", few terminals have it
+
+    /// Guess from $TERM
+    static TermCaps from_env();
+};
@@ -9,13 +9,10 @@ struct CharColor256 {
     // Constructors
     constexpr CharColor256() : term_color(0) {}
     constexpr explicit CharColor256(uint8_t color) : term_color(color) {}
-    constexpr CharColor256(const CharColor256& other) : term_color(other.term_color) {}
+    constexpr CharColor256(const CharColor256& other) = default;
 
     // Assignment operators
-    CharColor256& operator=(const CharColor256& other) {
-        term_color = other.term_color;
-        return *this;
-    }
+    CharColor256& operator=(const CharColor256& other) = default;
     CharColor256& operator=(uint8_t color) {
         term_color = color;
         return *this;
@@ -47,6 +44,38 @@ struct CharColor256Bg : public CharColor256 {
 };
 
 
+/// Palette index or 24-bit color, the cell color of WideCell
+struct TrueColor {
+    static constexpr uint32_t rgb_flag = uint32_t(1) << 24;
+
+    uint32_t value;     //< Palette index, or 0xRRGGBB | rgb_flag
+
+    static constexpr TrueColor indexed(uint8_t index) {
+        return {index};
+    }
+
+    static constexpr TrueColor rgb(uint8_t red, uint8_t green, uint8_t blue) {
+        return {rgb_flag | uint32_t(red) << 16 | uint32_t(green) << 8 | blue};
+    }
+
+    constexpr bool is_rgb() const noexcept { return value & rgb_flag; }
+    constexpr uint8_t index() const noexcept { return uint8_t(value); }
+    constexpr uint8_t red() const noexcept { return uint8_t(value >> 16); }
+    constexpr uint8_t green() const noexcept { return uint8_t(value >> 8); }
+    constexpr uint8_t blue() const noexcept { return uint8_t(value); }
+
+    /// Nearest entry of the xterm 6x6x6 color cube for 24-bit colors
+    constexpr uint8_t to_palette() const noexcept {
+        if (not is_rgb())
+            return index();
+        auto level = [](uint8_t c) { return c < 48 ? 0 : c < 115 ? 1 : (c - 35) / 40; };
+        return uint8_t(16 + 36 * level(red()) + 6 * level(green()) + level(blue()));
+    }
+
+    friend constexpr bool operator==(TrueColor, TrueColor) = default;
+};
+
+
 // Color constants
 constexpr inline CharColor256 color_black{0};
 constexpr inline CharColor256 color_red{1};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string_view>
+
+
+
+
+/** write_frame
+ *
+ * Writes a whole frame, one write(2) unless the fd takes it in parts.
+ * Retries interrupted and partial writes.
+ *
+ * @return  False on a write error
+ */
+bool write_frame(int fd, std::string_view frame);
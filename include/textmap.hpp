@@ -1,56 +1,317 @@
 #ifndef TEXTMAP_HPP
 #define TEXTMAP_HPP
 
+#include <type_traits>
+#include "cellpolicy.hpp"
 #include "consolearea.hpp"
+#include "sgrcache.hpp"
+#include "termcaps.hpp"
 
 
 
-class TextMap : public ConsoleArea
+/// Cells of a view redrawn elsewhere, as reported by ConsoleArea::hint_move
+struct ViewMove
+{
+    Vector2u from, to, size;
+};
+
+/// Rows of a view scrolled in place, as reported by ConsoleArea::hint_scroll
+struct ViewScroll
+{
+    Rect2u rect;
+    int shift;      //< Rows moved up when positive
+};
+
+
+/** BasicTextMap
+ *
+ * Row-major cell storage in the format of a cell policy (see cellpolicy.hpp).
+ * The ConsoleArea interface converts from and to CharUnit, typed access
+ * works on the native cells.
+ */
+template<typename Policy>
+class BasicTextMap : public ConsoleArea
 {
 public:
-    TextMap(Vector2u size = {0, 0})
+    using Cell = typename Policy::Cell;
+
+    BasicTextMap(Vector2u size = {0, 0})
         : ConsoleArea(size)
     {
-        _map.resize(size.x * size.y, CharUnit::none);
+        _map.resize(size.x * size.y, Policy::none());
+        _row_hash.resize(size.y, stale_hash);
     }
 
     void set_char(Vector2u pos, CharUnit&& ch) override
     {
-        if (pos < size)
-            _map[pos.x + pos.y * size.x] = std::move(ch);
+        set_cell(pos, Policy::from_unit(ch));
     }
 
+    /// Other formats are converted into a scratch unit, valid until the next get_char
     CharUnit const& get_char(Vector2u pos) const override
     {
-        if (pos < size)
+        if (not (pos < size))
+            return CharUnit::none;
+        if constexpr (std::is_same_v<Cell, CharUnit>)
             return _map[pos.x + pos.y * size.x];
-        return CharUnit::none;
+        else
+            return _unit = Policy::to_unit(_map[pos.x + pos.y * size.x]);
+    }
+
+    void write_span(unsigned row, unsigned x, const CharUnit* cells, unsigned count) override
+    {
+        if (row >= size.y or x >= size.x)
+            return;
+        count = std::min(count, size.x - x);
+        if constexpr (std::is_same_v<Cell, CharUnit>)
+            std::copy_n(cells, count, &_map[row * size.x + x]);
+        else
+            for (unsigned i = 0; i < count; i++)
+                _map[row * size.x + x + i] = Policy::from_unit(cells[i]);
+        touch_rows(row, row + 1);
+    }
+
+    void fill_rect(Rect2u rect, const CharUnit& unit) override
+    {
+        fill_cells(rect, Policy::from_unit(unit));
+    }
+
+    const CharUnit* span_data(Vector2u pos) const override
+    {
+        if constexpr (std::is_same_v<Cell, CharUnit>)
+            return pos < size ? &_map[pos.x + pos.y * size.x] : nullptr;
+        else
+            return nullptr;
     }
 
 public:
-    static TextMap create_from(std::string const& tex);
+    /// Native cell at `pos`, Policy::none() outside
+    const Cell& cell(Vector2u pos) const
+    {
+        return pos < size ? _map[pos.x + pos.y * size.x] : Policy::none();
+    }
+
+    void set_cell(Vector2u pos, const Cell& cell)
+    {
+        if (pos < size) {
+            _map[pos.x + pos.y * size.x] = cell;
+            touch_rows(pos.y, pos.y + 1);
+        }
+    }
+
+    /// write_span without conversion
+    void write_cells(unsigned row, unsigned x, const Cell* cells, unsigned count)
+    {
+        if (row >= size.y or x >= size.x)
+            return;
+        std::copy_n(cells, std::min(count, size.x - x), &_map[row * size.x + x]);
+        touch_rows(row, row + 1);
+    }
+
+    /// fill_rect without conversion
+    void fill_cells(Rect2u rect, const Cell& cell);
+
+public:
+    static BasicTextMap create_from(std::string const& tex);
     void load_from(std::string const& tex);
-    void resize(Vector2u size);
+
+    /** resize
+     *
+     * Moves the rows in place and keeps the storage, only growth past the
+     * capacity allocates. Cells past the old size become Policy::none().
+     *
+     * @param[in] reflow  Rewrap lines to the new width instead of clipping
+     *                    them, a row with a used last cell continues on the next
+     */
+    void resize(Vector2u size, bool reflow = false);
 
 public:
-    TextMap strip() const;
+    BasicTextMap strip() const;
+
+public:
+    /// Cells of row `y`, `size.x` of them
+    const Cell* row_data(unsigned y) const { return &_map[y * size.x]; }
+
+    /// hash_cells of row `y`, cached until the row is written
+    uint64_t row_hash(unsigned y) const;
+
+    /** shift_rows
+     *
+     * Moves the cells of columns [from.x, to.x) in rows [from.y, to.y)
+     * by `shift` rows, up when positive. Exposed cells become `blank`.
+     */
+    void shift_rows(Vector2u from, Vector2u to, int shift, const Cell& blank);
+
+    /// Copies a `size` rectangle from `from` to `to`, overlapping is fine
+    void copy_rect(Vector2u from, Vector2u to, Vector2u size);
 
 protected:
-    std::vector<CharUnit> _map;
+    /// Rows [top, bottom) were written, their hash is stale and the next diff looks at them
+    void touch_rows(unsigned top, unsigned bottom)
+    {
+        for (unsigned y = top; y < bottom; y++)
+            _row_hash[y] = stale_hash;
+        damage_rows(top, bottom);
+    }
+
+    /// Rows [top, bottom) count as damaged for the next print_diff
+    void damage_rows(unsigned top, unsigned bottom)
+    {
+        _damaged_rows.resize(size.y);
+        for (unsigned y = top; y < std::min(bottom, size.y); y++) {
+            _damaged_count += not _damaged_rows[y];
+            _damaged_rows[y] = 1;
+        }
+    }
+
+protected:
+    /// Cached row hash that must be recomputed
+    static constexpr uint64_t stale_hash = 0;
+
+    std::vector<Cell> _map;
+    mutable std::vector<uint64_t> _row_hash;
+    std::vector<uint8_t> _damaged_rows; //< Rows written or hinted since the last diff, empty when none were
+    unsigned _damaged_count = 0;
+    mutable CharUnit _unit{};       //< get_char result of converted formats
+    std::vector<Cell> _scratch;     //< Old cells while reflowing, capacity kept between resizes
+
+private:
+    void reflow_to(Vector2u size);
+
+    template<typename> friend class BasicSTDIOTextArea;
 
 };
 
 
-class STDIOTextArea : public TextMap
+struct ScrollMotion;
+
+
+/** BasicSTDIOTextArea
+ *
+ * BasicTextMap rendered to escape sequences with the encoder of its cell
+ * policy, as a full repaint or as the difference to the last frame.
+ */
+template<typename Policy>
+class BasicSTDIOTextArea : public BasicTextMap<Policy>
 {
 public:
-    using TextMap::TextMap;
+    using Cell = typename Policy::Cell;
+    using Meta = typename Policy::Meta;
+    using MoveHint = ViewMove;
+
+    using BasicTextMap<Policy>::BasicTextMap;
+    using BasicTextMap<Policy>::size;
 
 public:
+    /// Full repaint of the area, appended to `old`
     std::string print(std::string&& old = {}) const;
+    /// Repaint only the cells that differ from the last presented frame
+    std::string print_diff(std::string&& old = {});
+    /// print_diff inside a synchronized update, nothing is appended when nothing changed
+    std::string print_frame(std::string&& old = {});
+    /// Drop the front buffer, the next print_diff repaints everything
+    void invalidate();
+
+    /// Recorded for the next print_diff, which may copy the cells on the terminal
+    void hint_move(Vector2u from, Vector2u to, Vector2u size) override;
+    /// Recorded for the next print_diff, which may scroll the rows on the terminal
+    void hint_scroll(Rect2u rect, int shift) override;
+    /// Recorded for the next print_diff, which diffs only the rows written or
+    /// hinted since the last one. Writes mark their rows themselves, a hint
+    /// never hides them.
+    void hint_damage(Rect2u rect) override;
+
+    /// Bytes the cost model predicted against bytes written, per frame sums
+    struct RenderStats
+    {
+        uint64_t frames = 0;
+        uint64_t estimated_bytes = 0;
+        uint64_t written_bytes = 0;
+
+        void add(uint64_t estimated, uint64_t written) {
+            ++frames;
+            estimated_bytes += estimated;
+            written_bytes += written;
+        }
+    };
+
+    const BasicSgrTransitionCache<Policy>& sgr_cache() const { return _sgr_cache; }
+    const RenderStats& render_stats() const { return _render_stats; }
+    void reset_render_stats() { _render_stats = {}; }
+
+public:
+    TermCaps caps;          //< Sequences the renderer may use
+
+private:
+    using BasicTextMap<Policy>::_map;
+    using BasicTextMap<Policy>::_damaged_rows;
+    using BasicTextMap<Policy>::_damaged_count;
+    using BasicTextMap<Policy>::damage_rows;
+
+    /// Terminal cursor and SGR state while painting
+    struct Pen
+    {
+        Vector2u cursor;
+        Meta meta;
+        size_t bytes;       //< Predicted output so far
+    };
+
+    /** move_pen
+     *
+     * Moves the cursor by the cheapest motion, which may reprint the cells
+     * in between. `target` is the meta painted next.
+     *
+     * @return  Bytes written
+     */
+    unsigned move_pen(EscapeWriter& out, Pen& pen, Vector2u to,
+                      const Cell* row, const Meta& target) const;
+
+    /** paint_run
+     *
+     * Paints `count` cells at `pos` that all look like the first one, as
+     * REP, ECH or EL when that is shorter than printing them.
+     *
+     * @param[in]  run_end  First column past the run of look-alike cells
+     * @return     Cells painted, 1 when plain glyphs win, up to the row end after EL
+     */
+    unsigned paint_run(EscapeWriter& out, Pen& pen, const Cell* row,
+                       Vector2u pos, unsigned count, unsigned run_end) const;
+
+    /// Sends the shift and applies it to the front buffer
+    void scroll_front(EscapeWriter& out, Pen& pen, const ScrollMotion& scroll);
+
+private:
+    mutable BasicSgrTransitionCache<Policy> _sgr_cache;  //< Shared by every cell of every frame
+    mutable RenderStats _render_stats;
+    BasicTextMap<Policy> _front;    //< What the terminal shows after the last print_diff
+    std::vector<MoveHint> _moves;   //< Since the last print_diff
+    std::vector<ViewScroll> _scrolls;   //< Since the last print_diff
+    std::vector<uint32_t> _diff_masks;  //< Changed cells of the row being diffed
+    bool _front_valid = false;
 
 };
 
 
+/// CharUnit cells, the default
+using TextMap = BasicTextMap<StandardCellPolicy>;
+using STDIOTextArea = BasicSTDIOTextArea<StandardCellPolicy>;
+
+/// 4-byte ASCII cells for large canvases
+using CompactTextMap = BasicTextMap<CompactCellPolicy>;
+using CompactSTDIOTextArea = BasicSTDIOTextArea<CompactCellPolicy>;
+
+/// 16-byte cells with 24-bit colors and graphemes
+using WideTextMap = BasicTextMap<WideCellPolicy>;
+using WideSTDIOTextArea = BasicSTDIOTextArea<WideCellPolicy>;
+
+// Defined in textmap.cpp for the policies above
+extern template class BasicTextMap<StandardCellPolicy>;
+extern template class BasicTextMap<CompactCellPolicy>;
+extern template class BasicTextMap<WideCellPolicy>;
+extern template class BasicSTDIOTextArea<StandardCellPolicy>;
+extern template class BasicSTDIOTextArea<CompactCellPolicy>;
+extern template class BasicSTDIOTextArea<WideCellPolicy>;
+
+
 
 #endif // TEXTMAP_HPP
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+
+/** ThreadPool
+ *
+ * Fixed workers with a deque of task indices each. parallel_for deals the
+ * indices out round robin, a worker that runs dry steals from the back of
+ * the others. The calling thread works too and returns once every index
+ * ran, the first exception of a task is rethrown there.
+ */
+class ThreadPool
+{
+public:
+    /// Shared pool with a worker for every other hardware thread
+    static ThreadPool& shared();
+
+    explicit ThreadPool(unsigned workers);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+public:
+    /// Threads running tasks, the caller included
+    unsigned concurrency() const noexcept { return unsigned(_threads.size()) + 1; }
+
+    /// Runs task(i) for every i in [0, count), one batch at a time
+    void parallel_for(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<size_t> items;
+    };
+
+    void work(unsigned self);
+    /// Runs one index from queue `self` or stolen from another, false when all are empty
+    bool run_one(unsigned self);
+
+private:
+    std::vector<std::unique_ptr<Queue>> _queues;    //< One per worker, the caller's last
+    std::vector<std::thread> _threads;
+    std::mutex _batch;              //< Held by the caller of parallel_for
+
+    std::mutex _mutex;              //< Guards the members below
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    const std::function<void(size_t)>* _task = nullptr;
+    size_t _pending = 0;
+    uint64_t _generation = 0;
+    std::exception_ptr _error;
+    bool _stop = false;
+
+};
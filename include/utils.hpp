@@ -2,6 +2,7 @@
 #define UTILS_HPP
 
 
+#include <algorithm>
 #include <map>
 #include <stdint.h>
 #include <string>
@@ -57,6 +58,52 @@ DECLARE_VECTOR2_LOGIC_OPERATOR(==)
 DECLARE_VECTOR2_LOGIC_OPERATOR(!=)
 
 
+template<typename T>
+struct Rect2
+{
+    Vector2<T> position;
+    Vector2<T> size;
+
+    Vector2<T> end() const { return position + size; }
+    bool empty() const { return size.x == 0 or size.y == 0; }
+
+    /// Part of the rect inside `bounds`, empty when they don't overlap
+    Rect2 clipped(Rect2 bounds) const {
+        T left = std::max(position.x, bounds.position.x);
+        T top = std::max(position.y, bounds.position.y);
+        T right = std::min(end().x, bounds.end().x);
+        T bottom = std::min(end().y, bounds.end().y);
+        if (right <= left or bottom <= top)
+            return {{left, top}, {0, 0}};
+        return {{left, top}, {right - left, bottom - top}};
+    }
+
+    /// Smallest rect holding both, an empty one is ignored
+    Rect2 united(Rect2 other) const {
+        if (empty())
+            return other;
+        if (other.empty())
+            return *this;
+        T left = std::min(position.x, other.position.x);
+        T top = std::min(position.y, other.position.y);
+        T right = std::max(end().x, other.end().x);
+        T bottom = std::max(end().y, other.end().y);
+        return {{left, top}, {right - left, bottom - top}};
+    }
+
+    bool intersects(Rect2 other) const {
+        return not clipped(other).empty();
+    }
+
+    bool operator==(const Rect2& other) const {
+        return position == other.position and size == other.size;
+    }
+};
+
+
+using Rect2u = Rect2<unsigned>;
+
+
 
 inline std::string escape_string(std::string_view sv)
 {
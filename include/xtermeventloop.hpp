@@ -1,6 +1,7 @@
 #pragma once
 
 #include "consoleevent.hpp"
+#include <condition_variable>
 #include <queue>
 
 
@@ -12,8 +13,8 @@ private:
     class EventReceiver : public ExtendedConsoleEventReceiver
     {
     public:
-        EventReceiver(std::mutex& mutex, std::queue<AnyConsoleEvent>& queue)
-            : mutex(mutex), queue(queue) {}
+        EventReceiver(std::mutex& mutex, std::queue<AnyConsoleEvent>& queue, std::atomic<bool>& exiting)
+            : mutex(mutex), queue(queue), exiting(exiting) {}
 
     public:
         void on_any_event(AnyConsoleEvent&& ev) override
@@ -22,9 +23,24 @@ private:
             queue.push(std::move(ev));
         }
 
+        /// Handed to poll() instead of queued, the text is not copied out
+        /// of the read buffer. The reader waits until it was dispatched.
+        void on_event(const conevent::PasteEvent& event) override
+        {
+            std::unique_lock lock(mutex);
+            paste = &event;
+            handed.wait(lock, [&] { return not paste or exiting; });
+            paste = nullptr;
+        }
+
+    public:
+        const conevent::PasteEvent* paste = nullptr;   //< Waiting for poll(), guarded by the mutex
+        std::condition_variable handed;
+
     private:
         std::mutex& mutex;
         std::queue<AnyConsoleEvent>& queue;
+        std::atomic<bool>& exiting;
 
     };
 
@@ -33,6 +49,9 @@ public:
     ~XTermEventLoop();
 
 private:
+    /// Quiet time after an ESC before it counts as the Escape key
+    static constexpr long escape_timeout_us = 40'000;
+
     void loop();
 
 public:
@@ -0,0 +1,139 @@
+#include "cellkernels.hpp"
+
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CELLKERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+
+
+// Interleaved cells are compared as one 64-bit word each
+static_assert(sizeof(CharUnit) == 8 and std::has_unique_object_representations_v<CharUnit>);
+// Other formats bytewise as well
+static_assert(std::has_unique_object_representations_v<CompactCell>);
+static_assert(std::has_unique_object_representations_v<WideCell>);
+
+
+namespace
+{
+
+
+using namespace cellkernels;
+
+
+uint64_t cell_word(const CharUnit* cell)
+{
+    uint64_t word;
+    std::memcpy(&word, cell, sizeof(word));
+    return word;
+}
+
+
+// Scalar
+
+void diff_masks_scalar(const CharUnit* a, const CharUnit* b, size_t begin, size_t count, uint32_t* masks)
+{
+    for (size_t i = begin; i < count; i++) {
+        if (i % block == 0)
+            masks[i / block] = 0;
+        masks[i / block] |= uint32_t(cell_word(a + i) != cell_word(b + i)) << (i % block);
+    }
+}
+
+template<typename Cell>
+void diff_cells_scalar(const Cell* a, const Cell* b, size_t count, uint32_t* masks)
+{
+    for (size_t base = 0; base < count; base += block) {
+        uint32_t mask = 0;
+        for (size_t i = base; i < std::min(count, base + block); i++)
+            mask |= uint32_t(std::memcmp(a + i, b + i, sizeof(Cell)) != 0) << (i - base);
+        masks[base / block] = mask;
+    }
+}
+
+
+#ifdef CELLKERNELS_X86
+
+// SSE2, baseline on x86-64
+
+__attribute__((target("sse2")))
+void diff_masks_sse2(const CharUnit* a, const CharUnit* b, size_t count, uint32_t* masks)
+{
+    size_t full = count / block * block;
+    for (size_t base = 0; base < full; base += block) {
+        uint32_t equal = 0;
+        // Two cells per load, a cell is equal when both of its dwords are
+        for (size_t k = 0; k < block / 2; k++) {
+            auto va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + base + 2 * k));
+            auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + base + 2 * k));
+            int dwords = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb)));
+            uint32_t cells = uint32_t((dwords & 3) == 3) | uint32_t((dwords & 12) == 12) << 1;
+            equal |= cells << (2 * k);
+        }
+        masks[base / block] = ~equal;
+    }
+    diff_masks_scalar(a, b, full, count, masks);
+}
+
+
+// AVX2
+
+__attribute__((target("avx2")))
+void diff_masks_avx2(const CharUnit* a, const CharUnit* b, size_t count, uint32_t* masks)
+{
+    size_t full = count / block * block;
+    for (size_t base = 0; base < full; base += block) {
+        uint32_t equal = 0;
+        for (size_t k = 0; k < block / 4; k++) {
+            auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + base + 4 * k));
+            auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + base + 4 * k));
+            auto eq = _mm256_castsi256_pd(_mm256_cmpeq_epi64(va, vb));
+            equal |= uint32_t(_mm256_movemask_pd(eq)) << (4 * k);
+        }
+        masks[base / block] = ~equal;
+    }
+    diff_masks_scalar(a, b, full, count, masks);
+}
+
+#endif
+
+
+using DiffKernel = void (*)(const CharUnit*, const CharUnit*, size_t, uint32_t*);
+
+DiffKernel select_diff()
+{
+#ifdef CELLKERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return diff_masks_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return diff_masks_sse2;
+#endif
+    return [](const CharUnit* a, const CharUnit* b, size_t count, uint32_t* masks) {
+        diff_masks_scalar(a, b, 0, count, masks);
+    };
+}
+
+
+}
+
+
+
+void cellkernels::diff_masks(const CharUnit* a, const CharUnit* b, size_t count, uint32_t* masks)
+{
+    static const DiffKernel diff = select_diff();
+    diff(a, b, count, masks);
+}
+
+void cellkernels::diff_masks(const CompactCell* a, const CompactCell* b, size_t count, uint32_t* masks)
+{
+    diff_cells_scalar(a, b, count, masks);
+}
+
+void cellkernels::diff_masks(const WideCell* a, const WideCell* b, size_t count, uint32_t* masks)
+{
+    diff_cells_scalar(a, b, count, masks);
+}
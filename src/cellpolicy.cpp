@@ -0,0 +1,96 @@
+#include "cellpolicy.hpp"
+
+
+
+namespace
+{
+
+
+/// Code point at the start of `text` and its byte length, 0 bytes when malformed
+std::pair<char32_t, size_t> decode_utf8(std::string_view text)
+{
+    if (text.empty())
+        return {0, 0};
+    auto lead = static_cast<unsigned char>(text[0]);
+    size_t len = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+    if (len == 0 or text.size() < len)
+        return {0, 0};
+    char32_t code = len == 1 ? lead : lead & (0x7F >> len);
+    for (size_t i = 1; i < len; i++) {
+        auto byte = static_cast<unsigned char>(text[i]);
+        if ((byte & 0xC0) != 0x80)
+            return {0, 0};
+        code = code << 6 | (byte & 0x3F);
+    }
+    return {code, len};
+}
+
+bool printable(char32_t code)
+{
+    return code >= U' ' and code != 0x7F and not (code >= 0x80 and code < 0xA0)
+            and not (code >= 0xD800 and code < 0xE000) and code <= 0x10FFFF;
+}
+
+
+}
+
+
+
+GraphemeTable& GraphemeTable::shared()
+{
+    static GraphemeTable table;
+    return table;
+}
+
+char32_t GraphemeTable::intern(std::string_view cluster)
+{
+    auto [code, len] = decode_utf8(cluster);
+    if (len != 0 and len == cluster.size())
+        return code;
+
+    std::lock_guard lock(_mutex);
+    auto found = _ids.find(cluster);
+    if (found != _ids.end())
+        return WideCell::grapheme_bit | found->second;
+    auto id = static_cast<uint32_t>(_clusters.size());
+    _ids.emplace(_clusters.emplace_back(cluster), id);
+    return WideCell::grapheme_bit | id;
+}
+
+std::string_view GraphemeTable::lookup(char32_t ref) const
+{
+    std::lock_guard lock(_mutex);
+    auto id = ref & ~WideCell::grapheme_bit;
+    return id < _clusters.size() ? std::string_view(_clusters[id]) : std::string_view("?");
+}
+
+
+CharUnit WideCellPolicy::to_unit(const Cell& cell)
+{
+    char32_t character = cell.character;
+    if (character & WideCell::grapheme_bit)
+        character = decode_utf8(GraphemeTable::shared().lookup(character)).first;
+    return {wchar_t(character), {CharColor256Bg{cell.meta.background.to_palette()},
+                                 CharColor256Fg{cell.meta.foreground.to_palette()},
+                                 uint16_t(cell.meta.styles)}};
+}
+
+unsigned WideCellPolicy::glyph_length(const Cell& cell)
+{
+    if (cell.character & WideCell::grapheme_bit)
+        return static_cast<unsigned>(GraphemeTable::shared().lookup(cell.character).size());
+    return printable(cell.character) ? utf8_length(cell.character) : 1;
+}
+
+void WideCellPolicy::glyph(EscapeWriter& out, const Cell& cell)
+{
+    if (cell.character & WideCell::grapheme_bit) {
+        auto cluster = GraphemeTable::shared().lookup(cell.character);
+        out.reserve(cluster.size());
+        out.put(cluster.data(), cluster.size());
+    }
+    else if (printable(cell.character))
+        out.utf8(cell.character);
+    else
+        out.glyph(cell.character == U'\0' ? L'\0' : L'?');
+}
@@ -1,5 +1,7 @@
 #include "consoleevent.hpp"
 
+#include <cstring>
+
 
 
 using namespace conevent;
@@ -19,23 +21,91 @@ void XTermConsoleEventSender::xterm_arrow(int count, char chr)
     _receiver.on_event(event);
 }
 
+void XTermConsoleEventSender::xterm_key(char chr)
+{
+    KeyboardEvent event;
+    switch (chr) {
+    case 'A': event.key = Key::Up; break;
+    case 'B': event.key = Key::Down; break;
+    case 'C': event.key = Key::Right; break;
+    case 'D': event.key = Key::Left; break;
+    case 'H': event.key = Key::Home; break;
+    case 'F': event.key = Key::End; break;
+    default:
+        // SS3 P to S
+        event.key = static_cast<Key>(static_cast<int>(Key::F1) + chr - 'P');
+        break;
+    }
+    _receiver.on_event(event);
+}
+
+void XTermConsoleEventSender::xterm_alt(char chr)
+{
+    KeyboardEvent event;
+    event.status = CtrlStatus::Alt;
+    if ('a' <= chr and chr <= 'z')
+        event.key = static_cast<Key>(static_cast<int>(Key::A) + chr - 'a');
+    else if ('A' <= chr and chr <= 'Z') {
+        event.key = static_cast<Key>(static_cast<int>(Key::A) + chr - 'A');
+        event.status = CtrlStatus::Alt | CtrlStatus::Shift;
+    }
+    else if ('0' <= chr and chr <= '9')
+        event.key = static_cast<Key>(static_cast<int>(Key::Num0) + chr - '0');
+    else if (chr == ' ')
+        event.key = Key::Space;
+    else if (chr == 0x7F)
+        event.key = Key::Backspace;
+    else
+        event.key = Key::Unknown;
+    _receiver.on_event(event);
+}
+
 void XTermConsoleEventSender::xterm_status(int status)
 {
-    if (status != 3 and status != 0)
-        throw std::runtime_error("Unknown  xterm status " + std::to_string(status));
+    if (status != 3 and status != 0) {
+        _parse_context.reject();
+        Log->debug("Unknown xterm status {}", status);
+        return;
+    }
     _receiver.on_event(XTermStatusEvent{status});
 }
 
 void XTermConsoleEventSender::xterm_fn_key(int key)
 {
+    // \e[200~ opens a bracketed paste, a stray \e[201~ closes nothing
+    if (key == 200) {
+        _pasting = true;
+        _paste.clear();
+        _paste_match = 0;
+        return;
+    }
+    if (key == 201)
+        return;
+
     KeyboardEvent event;
-    auto fn_index = key - 11;
-    if (fn_index >= 0 && fn_index < 12) {
-        event.key = static_cast<Key>(fn_index + static_cast<int>(Key::F1));
-        _receiver.on_event(event);
-    } else {
-        throw std::runtime_error("Unknown Fn key " + std::to_string(fn_index));
+    switch (key) {
+    case 1: case 7: event.key = Key::Home; break;
+    case 2: event.key = Key::Insert; break;
+    case 3: event.key = Key::Delete; break;
+    case 4: case 8: event.key = Key::End; break;
+    case 5: event.key = Key::PageUp; break;
+    case 6: event.key = Key::PageDown; break;
+    // F1-F12 skip 16 and 22
+    case 11: case 12: case 13: case 14: case 15:
+        event.key = static_cast<Key>(static_cast<int>(Key::F1) + key - 11);
+        break;
+    case 17: case 18: case 19: case 20: case 21:
+        event.key = static_cast<Key>(static_cast<int>(Key::F6) + key - 17);
+        break;
+    case 23: case 24:
+        event.key = static_cast<Key>(static_cast<int>(Key::F11) + key - 23);
+        break;
+    default:
+        _parse_context.reject();
+        Log->debug("Unknown fn key {}", key);
+        return;
     }
+    _receiver.on_event(event);
 }
 
 void XTermConsoleEventSender::xterm_btn_urxvt_M(int btn, int x, int y)
@@ -93,7 +163,9 @@ void XTermConsoleEventSender::xterm_btn_sgr_m(int btn, int x, int y)
             | (btn & 8 ? CtrlStatus::Meta : CtrlStatus::None)
             | (btn & 16 ? CtrlStatus::Control : CtrlStatus::None);
     if (btn & 32) {
-        throw std::runtime_error("Motion at 'm' mod?");
+        // Release reports carry no motion
+        _parse_context.reject();
+        Log->debug("Motion in a release report, btn {}", btn);
     }
     else {
         MouseButtonEvent event;
@@ -111,3 +183,198 @@ void XTermConsoleEventSender::xterm_dsr(int x, int y)
     event.position = { static_cast<uint32_t>(x - 1), static_cast<uint32_t>(y - 1) };
     _receiver.on_event(event);
 }
+
+void XTermConsoleEventSender::on_bytes(std::span<const char> bytes)
+{
+    feed(bytes);
+}
+
+void XTermConsoleEventSender::on_idle()
+{
+    if (_parse_context.pending() == "\e") {
+        _parse_context.reset();
+        control('\e', 1);
+    }
+}
+
+bool XTermConsoleEventSender::feed(std::span<const char> bytes)
+{
+    bool ok = true;
+    size_t i = 0;
+    while (i < bytes.size()) {
+        if (_pasting) {
+            i += paste(bytes.subspan(i));
+            continue;
+        }
+        if (not _parse_context.idle()) {
+            bool lone = _parse_context.pending() == "\e";
+            // A second ESC right after the first, the first was the key
+            if (bytes[i] == '\e' and lone) {
+                _parse_context.reset();
+                control('\e', 1);
+                continue;
+            }
+            auto status = parse(bytes[i]);
+            if (status == escparse::ParseStatus::Ignored or status == escparse::ParseStatus::Unconsumed) {
+                // The byte goes again from the ground, so does Enter that
+                // broke a CSI. An ESC no sequence went on from was the key.
+                if (lone)
+                    control('\e', 1);
+                else
+                    ok &= status == escparse::ParseStatus::Ignored;
+                continue;
+            }
+            if (status == escparse::ParseStatus::Error and lone) {
+                // No sequence starts with ESC and this byte, it was the key
+                // and the byte is typed after it, as a fast ESC then a letter
+                _parse_context.reset();
+                control('\e', 1);
+                continue;
+            }
+            ok &= status != escparse::ParseStatus::Error;
+            i++;
+            continue;
+        }
+
+        // Sequences follow each other back to back in mouse reports
+        auto chr = bytes[i];
+        if (chr != '\e') {
+            auto run = inputscan::text_run(bytes.data() + i, bytes.size() - i);
+            if (run) {
+                text(bytes.subspan(i, run));
+                i += run;
+                continue;
+            }
+        }
+
+        _text.clear();
+        _utf8.interrupt(_text);
+        if (not _text.empty())
+            _receiver.on_event(TextInputEvent{_text});
+
+        if (chr == '\e') {
+            ok &= parse(bytes[i++]) != escparse::ParseStatus::Error;
+            continue;
+        }
+        // Held keys repeat, one event counts them
+        size_t end = i + 1;
+        while (end < bytes.size() and bytes[end] == chr)
+            end++;
+        control(chr, int(end - i));
+        i = end;
+    }
+    return ok;
+}
+
+void XTermConsoleEventSender::text(std::span<const char> bytes)
+{
+    _text.clear();
+    _utf8.decode({bytes.data(), bytes.size()}, _text);
+    if (not _text.empty())
+        _receiver.on_event(TextInputEvent{_text});
+}
+
+void XTermConsoleEventSender::control(char chr, int count)
+{
+    KeyboardEvent event;
+    event.count = count;
+    switch (chr) {
+    case '\r':
+    case '\n':
+        event.key = Key::Enter;
+        break;
+    case '\t':
+        event.key = Key::Tab;
+        break;
+    case '\b':
+    case 0x7F:
+        event.key = Key::Backspace;
+        break;
+    case '\e':
+        event.key = Key::Escape;
+        break;
+    case 0x00:
+        event.key = Key::Space;
+        event.status = CtrlStatus::Control;
+        break;
+    case 0x1C:
+        event.key = Key::Backslash;
+        event.status = CtrlStatus::Control;
+        break;
+    case 0x1D:
+        event.key = Key::RBracket;
+        event.status = CtrlStatus::Control;
+        break;
+    case 0x1E:
+        event.key = Key::Num6;
+        event.status = CtrlStatus::Control;
+        break;
+    case 0x1F:
+        event.key = Key::Slash;
+        event.status = CtrlStatus::Control;
+        break;
+    default:
+        // Ctrl-A to Ctrl-Z
+        event.key = static_cast<Key>(static_cast<int>(Key::A) + chr - 1);
+        event.status = CtrlStatus::Control;
+        break;
+    }
+    _receiver.on_event(event);
+}
+
+size_t XTermConsoleEventSender::paste(std::span<const char> bytes)
+{
+    constexpr std::string_view end_marker = "\e[201~";
+
+    auto finish = [&](size_t begin, size_t end) {
+        // Whole paste in this read, the event views the read buffer itself
+        std::string_view text(bytes.data() + begin, end - begin);
+        if (not _paste.empty())
+            text = _paste.append(text);
+        _pasting = false;
+        _paste_match = 0;
+        _receiver.on_event(PasteEvent{text});
+        _paste.clear();
+    };
+
+    size_t i = 0;
+    if (_paste_match) {
+        while (_paste_match < end_marker.size() and i < bytes.size() and bytes[i] == end_marker[_paste_match]) {
+            _paste_match++;
+            i++;
+        }
+        if (_paste_match == end_marker.size()) {
+            finish(0, 0);
+            return i;
+        }
+        if (i == bytes.size())
+            return i;
+        // The marker the last read began with was payload after all
+        _paste.append(end_marker.substr(0, _paste_match));
+        _paste_match = 0;
+    }
+
+    size_t begin = i;
+    while (true) {
+        auto esc = static_cast<const char*>(std::memchr(bytes.data() + i, '\e', bytes.size() - i));
+        if (not esc) {
+            _paste.append(bytes.data() + begin, bytes.size() - begin);
+            return bytes.size();
+        }
+        size_t at = size_t(esc - bytes.data());
+        size_t len = 1;
+        while (len < end_marker.size() and at + len < bytes.size() and bytes[at + len] == end_marker[len])
+            len++;
+        if (len == end_marker.size()) {
+            finish(begin, at);
+            return at + len;
+        }
+        if (at + len == bytes.size()) {
+            // The marker may go on in the next read
+            _paste.append(bytes.data() + begin, at - begin);
+            _paste_match = len;
+            return bytes.size();
+        }
+        i = at + 1;
+    }
+}
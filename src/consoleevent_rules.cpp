@@ -52,13 +52,29 @@ std::unique_ptr<escparse::BaseContainerRule> XTermConsoleEventSender::make_xterm
                     SkipChar('m')(this, &XTermConsoleEventSender::xterm_btn_sgr_m, "btn-sgr-<m")
                 });
 
+    // \e[<A-D|H|F> without a count
+    auto keys = ParseChar([](char chr) { return ('A' <= chr and chr <= 'D') or chr == 'H' or chr == 'F'; }, "<A-D,H,F>");
+    keys(this, &XTermConsoleEventSender::xterm_key, "csi-key");
+
     after_csi.append({
                          // \e[...
                          std::move(first_arg),
+                         std::move(keys),
                          (SkipChar('<'), ParseInt(), SkipChar(';'), ParseInt(), SkipChar(';'), std::move(sgrs)),
                      });
 
+    // \eO<A-D|H|F|P-S> in application cursor mode
+    auto ss3_keys = ParseChar([](char chr) { return ('A' <= chr and chr <= 'D') or chr == 'H' or chr == 'F'
+                                                    or ('P' <= chr and chr <= 'S'); }, "<A-D,H,F,P-S>");
+    ss3_keys(this, &XTermConsoleEventSender::xterm_key, "ss3-key");
+
+    // \e<chr> Alt chord, '[' and 'O' above win, \e\x7f is Alt+Backspace
+    auto alt = ParseChar([](char chr) { return 0x20 <= uint8_t(chr) and uint8_t(chr) <= 0x7F; }, "<alt>");
+    alt(this, &XTermConsoleEventSender::xterm_alt, "alt");
+
     auto csi = SkipChar('\e').append(std::move(after_csi));
+    csi.append(SkipChar('O').append(std::move(ss3_keys)));
+    csi.append(std::move(alt));
 
     Log->debug("Parse tree:\n{}", dump(&csi));
     return std::make_unique<SkipChar>(std::move(csi));
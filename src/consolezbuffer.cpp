@@ -1,5 +1,149 @@
 #include "../include/consolezbuffer.hpp"
 
+#include <span>
+
+
+
+
+namespace
+{
+
+
+/// Calls `visit(from, to)` for every part of [left, right) in `row` outside all `occluders`
+template<typename Visit>
+void for_each_visible(std::span<const Rect2u> occluders, unsigned row,
+                      unsigned left, unsigned right, Visit&& visit)
+{
+    // Few occluders, the ones around `x` are searched again each step
+    for (unsigned x = left; x < right; ) {
+        bool covered = true;
+        while (covered) {
+            covered = false;
+            for (auto& rect : occluders) {
+                if (row >= rect.position.y and row < rect.end().y
+                        and x >= rect.position.x and x < rect.end().x) {
+                    x = rect.end().x;
+                    covered = true;
+                }
+            }
+        }
+        if (x >= right)
+            return;
+        unsigned to = right;
+        for (auto& rect : occluders)
+            if (row >= rect.position.y and row < rect.end().y and rect.position.x > x)
+                to = std::min(to, rect.position.x);
+        visit(x, to);
+        x = to;
+    }
+}
+
+
+/// True when nothing of `rect` is outside `occluders`
+bool covered(Rect2u rect, std::span<const Rect2u> occluders)
+{
+    for (unsigned y = rect.position.y; y < rect.end().y; y++) {
+        bool visible = false;
+        for_each_visible(occluders, y, rect.position.x, rect.end().x, [&](unsigned, unsigned) { visible = true; });
+        if (visible)
+            return false;
+    }
+    return true;
+}
+
+
+/// Fills the cells of `rect` outside `occluders` of a row-major `plane` with `value`
+void stamp(std::vector<uint32_t>& plane, unsigned width, Rect2u rect,
+           std::span<const Rect2u> occluders, uint32_t value)
+{
+    for (unsigned y = rect.position.y; y < rect.end().y; y++)
+        for_each_visible(occluders, y, rect.position.x, rect.end().x, [&](unsigned from, unsigned to) {
+            std::fill(&plane[y * width + from], &plane[y * width + to], value);
+        });
+}
+
+
+/// Sets the cells of `rect` the view of `widget` contains() to `value`
+void stamp_hits(std::vector<uint32_t>& plane, unsigned width, Rect2u rect,
+                const ConsoleViewWidget& widget, uint32_t value)
+{
+    auto pos = widget.get_position();
+    auto& view = *widget.get_view();
+    // Views hit on their whole rect are stamped a row at a time
+    if (view.rect_hit())
+        return stamp(plane, width, rect, {}, value);
+    for (unsigned y = rect.position.y; y < rect.end().y; y++)
+        for (unsigned x = rect.position.x; x < rect.end().x; x++)
+            if (view.contains(Vector2u{x, y} - pos))
+                plane[y * width + x] = value;
+}
+
+
+/// Area writes limited to `clip` and kept off `occluders`, coordinates stay those of the area
+class ConsoleAreaClip : public ConsoleArea
+{
+public:
+    ConsoleAreaClip(ConsoleArea* area, Rect2u clip, std::span<const Rect2u> occluders = {})
+        : ConsoleArea(area->size), area(area), clip(clip), occluders(occluders) {}
+
+public:
+    void set_char(Vector2u pos, CharUnit&& ch) override {
+        if (inside(pos))
+            area->set_char(pos, std::move(ch));
+    }
+    const CharUnit& get_char(Vector2u pos) const override {
+        return area->get_char(pos);
+    }
+    void write_span(unsigned row, unsigned x, const CharUnit* cells, unsigned count) override {
+        if (row < clip.position.y or row >= clip.end().y)
+            return;
+        unsigned from = std::max(x, clip.position.x);
+        unsigned to = std::min(x + count, clip.end().x);
+        for_each_visible(occluders, row, from, to, [&](unsigned from, unsigned to) {
+            area->write_span(row, from, cells + (from - x), to - from);
+        });
+    }
+    void fill_rect(Rect2u rect, const CharUnit& unit) override {
+        rect = rect.clipped(clip);
+        if (rect.empty())
+            return;
+        if (occluders.empty())
+            return area->fill_rect(rect, unit);
+        for (unsigned y = rect.position.y; y < rect.end().y; y++)
+            for_each_visible(occluders, y, rect.position.x, rect.end().x, [&](unsigned from, unsigned to) {
+                area->fill_rect({{from, y}, {to - from, 1}}, unit);
+            });
+    }
+    const CharUnit* span_data(Vector2u pos) const override {
+        return area->span_data(pos);
+    }
+    void hint_move(Vector2u from, Vector2u to, Vector2u size) override {
+        area->hint_move(from, to, size);
+    }
+    void hint_scroll(Rect2u rect, int shift) override {
+        area->hint_scroll(rect, shift);
+    }
+
+private:
+    bool inside(Vector2u pos) const {
+        if (pos.x < clip.position.x or pos.y < clip.position.y
+                or pos.x >= clip.end().x or pos.y >= clip.end().y)
+            return false;
+        for (auto& rect : occluders)
+            if (pos.x >= rect.position.x and pos.y >= rect.position.y
+                    and pos.x < rect.end().x and pos.y < rect.end().y)
+                return false;
+        return true;
+    }
+
+private:
+    ConsoleArea* const area;
+    Rect2u clip;
+    std::span<const Rect2u> occluders;
+};
+
+
+}
 
 
 
@@ -15,28 +159,155 @@ void ConsoleZBuffer::add_view(std::shared_ptr<ConsoleViewWidget>&& view) {
             throw std::runtime_error("View " + name + " already exists");
     }
     views.push_back(std::move(view));
+    layers.emplace_back();
 }
 
 void ConsoleZBuffer::notify(const ViewNotifier* notifier) {
     Log->trace("ConsoleZBuffer::notify");
-    // пока что игнорим draw у нас полностью переписывает все
+    // Layers compare view revisions and widget footprints themselves on draw
 }
 
 void ConsoleZBuffer::draw(ConsoleArea *area) const {
     // Log->trace("ConsoleZBuffer::draw");
-    area->clear();
-    for (auto it = views.rbegin(); it != views.rend(); ++it) {
-        (*it)->draw(area);
+    Rect2u bounds{{0, 0}, area->size};
+    // A view drawn live last frame may have painted outside its new footprint
+    bool full = area != drawn_area or not (area->size == drawn_size) or live;
+    drawn_area = area;
+    drawn_size = area->size;
+    damage.clear();
+    occluders.assign(views.size(), Rect2u{});
+    live = false;
+    stale.clear();
+
+    // Top to bottom, so the opaque views over each one are known
+    for (size_t i = 0; i < views.size(); i++) {
+        auto& widget = *views[i];
+        auto& layer = layers[i];
+        auto footprint = widget.footprint(area->size);
+        if (not footprint) {
+            // Extent unknown, only a full repaint covers it
+            full = true;
+            live = true;
+            layer.view = nullptr;
+            layer.footprint.reset();
+            continue;
+        }
+        layer.cells = Rect2u{widget.get_position(), widget.get_view()->view_size()}.clipped(bounds);
+        layer.hidden = covered(*footprint, {occluders.data(), i});
+        if (widget.get_view()->opaque())
+            occluders[i] = layer.cells;
+
+        // Hidden views are neither drawn nor composited, their layer catches up once uncovered
+        layer.changed = layer.hidden ? std::nullopt : widget.take_changes(layer);
+        if (layer.changed)
+            stale.push_back(i);
+    }
+
+    // Each view draws into its own layer, so any of them may be drawn at once
+    auto render = [this](size_t k) { views[stale[k]]->render_layer(layers[stale[k]]); };
+    if (pool)
+        pool->parallel_for(stale.size(), render);
+    else
+        for (size_t k = 0; k < stale.size(); k++)
+            render(k);
+
+    for (size_t i = 0; i < views.size(); i++) {
+        auto& widget = *views[i];
+        auto& layer = layers[i];
+        auto footprint = widget.footprint(area->size);
+        if (not footprint)
+            continue;
+        auto changed = layer.changed.value_or(Rect2u{});
+        if (not (layer.footprint == footprint) or layer.highlighted != widget.is_highlighted()) {
+            // Moved, resized or highlighted: old and new cells both change
+            if (layer.footprint)
+                add_damage(*layer.footprint);
+            add_damage(*footprint);
+            layer.footprint = footprint;
+            layer.highlighted = widget.is_highlighted();
+        }
+        else if (not changed.empty()) {
+            auto pos = widget.get_position();
+            add_damage(Rect2u{changed.position + pos, changed.size}.clipped(bounds));
+        }
+        if (not layer.hidden)
+            widget.send_hints(area, layer);
+    }
+
+    // The pick plane is written along with the cells, each one holds the
+    // index + 1 of the top view whose contains() takes it, 0 for none.
+    // Views under opaque ones are stamped too, those may turn clicks down.
+    unsigned width = area->size.x;
+    if (full) {
+        ConsoleAreaClip(area, bounds, occluders).clear();
+        pick.assign(size_t(width) * area->size.y, 0);
+        for (size_t i = views.size(); i-- > 0;) {
+            ConsoleAreaClip clip(area, bounds, {occluders.data(), i});
+            if (not layers[i].footprint) {
+                views[i]->draw(&clip);
+                continue;
+            }
+            if (not layers[i].hidden)
+                views[i]->composite(&clip, layers[i]);
+            stamp_hits(pick, width, layers[i].cells, *views[i], uint32_t(i + 1));
+        }
+        area->hint_damage(bounds);
+        return;
+    }
+
+    // Each damaged rect is cleared and rebuilt from the layers over it, back
+    // to front, cells under opaque views are written once
+    for (auto& rect : damage) {
+        ConsoleAreaClip(area, rect, occluders).clear();
+        stamp(pick, width, rect, {}, 0);
+        for (size_t i = views.size(); i-- > 0;) {
+            if (not layers[i].hidden and layers[i].footprint->intersects(rect)) {
+                ConsoleAreaClip clip(area, rect, {occluders.data(), i});
+                views[i]->composite(&clip, layers[i]);
+            }
+            stamp_hits(pick, width, layers[i].cells.clipped(rect), *views[i], uint32_t(i + 1));
+        }
+        area->hint_damage(rect);
+    }
+}
+
+void ConsoleZBuffer::add_damage(Rect2u rect) const {
+    if (rect.empty())
+        return;
+    // Overlapping rects merge into their bounds, which may overlap others again
+    for (size_t i = 0; i < damage.size(); ) {
+        if (damage[i].intersects(rect)) {
+            rect = rect.united(damage[i]);
+            damage[i] = damage.back();
+            damage.pop_back();
+            i = 0;
+        }
+        else
+            i++;
     }
+    damage.push_back(rect);
 }
 
 ConsoleViewWidget* ConsoleZBuffer::get_widget_at(Vector2u position) {
-    for (auto it = views.rbegin(); it != views.rend(); ++it) {
-        auto pos = (*it)->get_position();
+    // One lookup in the pick plane of the last draw
+    if (not live and not pick.empty()) {
+        if (not (position < drawn_size))
+            return nullptr;
+        auto index = pick[position.y * drawn_size.x + position.x];
+        return index ? views[index - 1].get() : nullptr;
+    }
+    // Before the first draw or with views of unknown extent, same rule as
+    // the plane: the top view whose contains() takes the cell within its view_size
+    for (auto& widget : views) {
+        auto pos = widget->get_position();
+        if (not (position >= pos))
+            continue;
         auto off = position - pos;
-        if (position >= pos and (*it)->get_view()->contains(off)) {
-            return it->get();
-        }
+        auto size = widget->get_view()->view_size();
+        if (not (size == Vector2u{0, 0}) and not (off < size))
+            continue;
+        if (widget->get_view()->contains(off))
+            return widget.get();
     }
     return nullptr;
 }
@@ -59,31 +330,95 @@ const std::vector<std::shared_ptr<ConsoleViewWidget> > &ConsoleZBuffer::get_view
 void ConsoleViewWidget::draw(ConsoleArea* area) const {
     if (view) {
         // Log->trace("ConsoleViewWidget::draw");
+        // Moved views may be copied on the terminal instead of repainted
+        auto view_size = view->view_size();
+        if (drawn_position and not (*drawn_position == position) and view_size.x and view_size.y)
+            area->hint_move(*drawn_position, position, view_size);
+        drawn_position = position;
         ConsoleAreaRect rect(area, position, area->size - position);
         view->draw(&rect);
-        if (highlighted) {
-            auto size = area->size - position;
-            auto range = [](int st, int sp, int step) {
-                std::vector<int> range;
-                range.resize((sp - st) / step);
-                auto it = range.begin();
-                for (int i = st; i != sp; i += step)
-                    *it++ = i;
-                return range;
-            };
-            auto transform = [&rect](const std::vector<int>& range, auto&& position, auto&& op) {
-                for (auto e : range) {
-                    auto pos = position(e);
-                    auto ch = rect.get_char(pos);
-                    op(ch);
-                    rect.set_char(pos, std::move(ch));
-                }
-            };
-            auto hl = [](CharUnit& unit) { unit.meta.background = (uint8_t)236; };
-            transform(range(0, size.x - 1, 1), [&](int i) { return Vector2u{(unsigned)i, 0}; }, hl);
-            transform(range(0, size.y - 1, 1), [&](int i) { return Vector2u{0, (unsigned)i}; }, hl);
-            transform(range(size.x - 1, 0, -1), [&](int i) { return Vector2u{(unsigned)i, 0}; }, hl);
-            transform(range(size.y - 1, 0, -1), [&](int i) { return Vector2u{0, (unsigned)i}; }, hl);
-        }
+        if (highlighted)
+            draw_highlight(&rect);
     }
 }
+
+std::optional<Rect2u> ConsoleViewWidget::footprint(Vector2u area) const {
+    auto view_size = view ? view->view_size() : Vector2u{0, 0};
+    if (not view_size.x or not view_size.y)
+        return std::nullopt;
+    if (not (position < area))
+        return Rect2u{position, {0, 0}};
+    // The highlight border runs along the area edges
+    Rect2u rect{position, highlighted ? area - position : view_size};
+    return rect.clipped({{0, 0}, area});
+}
+
+std::optional<Rect2u> ConsoleViewWidget::take_changes(const ViewLayer& layer) const {
+    auto view_size = view->view_size();
+    bool same = layer.view == view.get() and layer.size == view_size;
+    if (same and layer.revision == view->revision())
+        return std::nullopt;
+    auto damage = view->take_damage();
+    Rect2u whole{{0, 0}, view_size};
+    return same ? damage.clipped(whole) : whole;
+}
+
+void ConsoleViewWidget::render_layer(ViewLayer& layer) const {
+    layer.reset(view->view_size());
+    view->draw(&layer);
+    layer.view = view.get();
+    layer.revision = view->revision();
+}
+
+void ConsoleViewWidget::send_hints(ConsoleArea* area, ViewLayer& layer) const {
+    // Moved views may be copied on the terminal instead of repainted
+    if (drawn_position and not (*drawn_position == position))
+        area->hint_move(*drawn_position, position, layer.size);
+    drawn_position = position;
+    ConsoleAreaRect rect(area, position, area->size - position);
+    for (auto& move : layer.moves)
+        rect.hint_move(move.from, move.to, move.size);
+    for (auto& scroll : layer.scrolls)
+        rect.hint_scroll(scroll.rect, scroll.shift);
+    layer.moves.clear();
+    layer.scrolls.clear();
+}
+
+void ConsoleViewWidget::composite(ConsoleArea* area, const ViewLayer& layer) const {
+    ConsoleAreaRect rect(area, position, area->size - position);
+    if (view->opaque())
+        rect.blit(layer, {{0, 0}, layer.size}, {0, 0});
+    else
+        // Cells the view left alone show the views below
+        for (unsigned y = 0; y < layer.size.y; y++)
+            layer.for_each_written(y, [&](unsigned from, unsigned to) {
+                rect.write_span(y, from, layer.span_data({from, y}), to - from);
+            });
+    if (highlighted)
+        draw_highlight(&rect);
+}
+
+void ConsoleViewWidget::draw_highlight(ConsoleArea* rect) const {
+    auto size = rect->size;
+    auto range = [](int st, int sp, int step) {
+        std::vector<int> range;
+        range.resize((sp - st) / step);
+        auto it = range.begin();
+        for (int i = st; i != sp; i += step)
+            *it++ = i;
+        return range;
+    };
+    auto transform = [rect](const std::vector<int>& range, auto&& position, auto&& op) {
+        for (auto e : range) {
+            auto pos = position(e);
+            auto ch = rect->get_char(pos);
+            op(ch);
+            rect->set_char(pos, std::move(ch));
+        }
+    };
+    auto hl = [](CharUnit& unit) { unit.meta.background = (uint8_t)236; };
+    transform(range(0, size.x - 1, 1), [&](int i) { return Vector2u{(unsigned)i, 0}; }, hl);
+    transform(range(0, size.y - 1, 1), [&](int i) { return Vector2u{0, (unsigned)i}; }, hl);
+    transform(range(size.x - 1, 0, -1), [&](int i) { return Vector2u{(unsigned)i, 0}; }, hl);
+    transform(range(size.y - 1, 0, -1), [&](int i) { return Vector2u{0, (unsigned)i}; }, hl);
+}
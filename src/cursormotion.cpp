@@ -0,0 +1,124 @@
+#include "cursormotion.hpp"
+#include "escapewriter.hpp"
+
+
+
+namespace
+{
+
+
+unsigned cup_cost(Vector2u to)
+{
+    if (to.x == 0)
+        return escape_csi_cost(to.y + 1);
+    return 4 + escape_number_len(to.y + 1) + escape_number_len(to.x + 1);
+}
+
+
+}
+
+
+
+CursorMotion CursorMotion::plan(Vector2u from, Vector2u to, unsigned reprint)
+{
+    CursorMotion best;
+    best.absolute = true;
+    best.cost = cup_cost(to);
+    if (from.y == cursor_unknown)
+        return best;
+
+    struct Option { Vertical kind; unsigned cost; unsigned column; };
+    Option verticals[3];
+    int count = 0;
+    if (from.y == to.y)
+        verticals[count++] = {Vertical::None, 0, from.x};
+    else {
+        if (from.y > to.y)
+            verticals[count++] = {Vertical::Up, escape_csi_cost(from.y - to.y), from.x};
+        else {
+            verticals[count++] = {Vertical::Down, escape_csi_cost(to.y - from.y), from.x};
+            // LF may be expanded to CR LF by the tty, count both bytes
+            verticals[count++] = {Vertical::Newline, 1 + 2 * (to.y - from.y), 0};
+        }
+        verticals[count++] = {Vertical::Row, escape_csi_cost(to.y + 1), from.x};
+    }
+
+    auto consider = [&](const Option& v, Horizontal h, unsigned cost) {
+        if (v.cost + cost < best.cost) {
+            best.absolute = false;
+            best.vertical = v.kind;
+            best.horizontal = h;
+            best.cost = v.cost + cost;
+        }
+    };
+
+    for (int i = 0; i < count; i++) {
+        const auto& v = verticals[i];
+        unsigned column = v.column;
+        if (column == to.x) {
+            consider(v, Horizontal::None, 0);
+            continue;
+        }
+        consider(v, Horizontal::Column, escape_csi_cost(to.x + 1));
+        if (to.x == 0)
+            consider(v, Horizontal::Return, 1);
+        if (column == cursor_unknown) {
+            if (to.x != 0)
+                consider(v, Horizontal::ReturnForward, 1 + escape_csi_cost(to.x));
+        }
+        else if (to.x > column) {
+            consider(v, Horizontal::Forward, escape_csi_cost(to.x - column));
+            if (v.kind == Vertical::None and reprint != cursor_unknown)
+                consider(v, Horizontal::Reprint, reprint);
+        }
+        else {
+            consider(v, Horizontal::Backward, escape_csi_cost(column - to.x));
+            consider(v, Horizontal::Backspace, column - to.x);
+        }
+    }
+    return best;
+}
+
+void CursorMotion::emit(EscapeWriter& out, Vector2u from, Vector2u to) const
+{
+    if (absolute) {
+        out.jump(to.x, to.y);
+        return;
+    }
+
+    switch (vertical) {
+    case Vertical::None: break;
+    case Vertical::Up: out.csi(from.y - to.y, 'A'); break;
+    case Vertical::Down: out.csi(to.y - from.y, 'B'); break;
+    case Vertical::Row: out.csi(to.y + 1, 'd'); break;
+    case Vertical::Newline:
+        out.reserve(1 + to.y - from.y);
+        out.put('\r');
+        for (unsigned y = from.y; y < to.y; y++)
+            out.put('\n');
+        from.x = 0;
+        break;
+    }
+
+    switch (horizontal) {
+    case Horizontal::None: break;
+    case Horizontal::Forward: out.csi(to.x - from.x, 'C'); break;
+    case Horizontal::Backward: out.csi(from.x - to.x, 'D'); break;
+    case Horizontal::Backspace:
+        out.reserve(from.x - to.x);
+        for (unsigned x = to.x; x < from.x; x++)
+            out.put('\b');
+        break;
+    case Horizontal::Column: out.csi(to.x + 1, 'G'); break;
+    case Horizontal::Return:
+        out.reserve(1);
+        out.put('\r');
+        break;
+    case Horizontal::ReturnForward:
+        out.reserve(1);
+        out.put('\r');
+        out.csi(to.x, 'C');
+        break;
+    case Horizontal::Reprint: break;
+    }
+}
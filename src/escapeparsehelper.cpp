@@ -1,6 +1,8 @@
 #include <escapeparsehelper.hpp>
 
+#include <climits>
 #include <iostream>
+#include <stdexcept>
 
 
 
@@ -88,3 +90,165 @@ std::unique_ptr<escparse::BaseContainerRule> escparse::make_xterm_rules()
 
     return std::make_unique<SkipChar>(std::move(csi));
 }
+
+
+
+escparse::ParseContext::ParseContext(const BaseContainerRule* root)
+{
+    add_state(nullptr, nullptr, 0);
+    enter(0, root, 0);
+}
+
+uint16_t escparse::ParseContext::add_state(const BaseContainerRule* rule, const BaseFinalFunction* final, size_t slots)
+{
+    if (_states.size() > UINT16_MAX)
+        throw std::runtime_error("Escape rule tree too large");
+    if (final and final->arity() > slots)
+        throw std::runtime_error("Final rule expects " + std::to_string(final->arity())
+                                 + " arguments, only " + std::to_string(slots) + " are parsed");
+    _states.push_back({rule, final});
+    _steps.resize(_states.size() * 256);
+    return uint16_t(_states.size() - 1);
+}
+
+uint16_t escparse::ParseContext::compile(const BaseContainerRule* rule, size_t slots)
+{
+    if (slots > max_arguments)
+        throw std::runtime_error("Escape rule has more than " + std::to_string(max_arguments) + " arguments");
+
+    // A final that pops no char is called on entering the rule, like before
+    // any child had a chance
+    const BaseFinalFunction* final = nullptr;
+    for (auto child : rule->child_rules()) {
+        if (child->type() == RuleType::Final and not child->pop_char()) {
+            if (final)
+                throw std::runtime_error("Invalid rule, double no pop char");
+            final = static_cast<const BaseFinalRule*>(child)->get_final();
+        }
+    }
+    auto state = add_state(rule, final, slots);
+    if (final)
+        return state;
+
+    // Numbers repeat before any child is tried
+    if (rule->argument() == RuleArgument::Int)
+        link(state, rule, state, Op::Digit, slots - 1);
+
+    // Earlier children win on bytes several of them accept
+    for (auto child : rule->child_rules()) {
+        if (child->type() == RuleType::Final) {
+            auto target = add_state(nullptr, static_cast<const BaseFinalRule*>(child)->get_final(), slots);
+            link(state, child, target, Op::Skip, 0);
+            continue;
+        }
+        enter(state, static_cast<const BaseContainerRule*>(child), slots);
+    }
+    return state;
+}
+
+void escparse::ParseContext::enter(uint16_t state, const BaseContainerRule* rule, size_t slots)
+{
+    switch (rule->argument()) {
+    case RuleArgument::None:
+        link(state, rule, compile(rule, slots), Op::Skip, 0);
+        break;
+    case RuleArgument::Int:
+        link(state, rule, compile(rule, slots + 1), Op::Start, slots);
+        break;
+    case RuleArgument::Char:
+        link(state, rule, compile(rule, slots + 1), Op::Byte, slots);
+        break;
+    }
+}
+
+void escparse::ParseContext::link(uint16_t state, const BaseRule* rule, uint16_t target, Op op, size_t slot)
+{
+    for (int byte = 0; byte < 256; byte++) {
+        auto& to = step(state, char(byte));
+        if (to.op == Op::Fail and rule->can_parse(char(byte)))
+            to = {target, op, uint8_t(slot)};
+    }
+}
+
+escparse::ParseStatus escparse::ParseContext::next(char chr)
+{
+    if (_invalid_stack) {
+        _stack_len = 0;
+        _invalid_stack = false;
+    }
+    if (_discard) {
+        // Parameter and intermediate bytes up to the final one belong to the
+        // broken sequence, anything else is parsed again
+        if (0x20 <= chr and chr < 0x40)
+            return ParseStatus::Pending;
+        _discard = false;
+        if (0x40 <= chr and chr < 0x7F)
+            return ParseStatus::Pending;
+    }
+    if (_stack_len < _stack.size())
+        _stack[_stack_len++] = chr;
+
+    const auto& to = step(_state, chr);
+    switch (to.op) {
+    case Op::Fail:
+        return fail(chr);
+    case Op::Skip:
+        break;
+    case Op::Start:
+        _args[to.slot] = chr - '0';
+        break;
+    case Op::Digit:
+        // Saturates instead of overflowing on absurd parameters
+        if (_args[to.slot] < INT_MAX / 10)
+            _args[to.slot] = _args[to.slot] * 10 + (chr - '0');
+        break;
+    case Op::Byte:
+        _args[to.slot] = uint8_t(chr);
+        break;
+    }
+
+    _state = to.state;
+    if (auto final = _states[_state].final) {
+        _state = 0;
+        _invalid_stack = true;
+        ++_stats.sequences;
+        if (Log->should_log(spdlog::level::trace))
+            Log->trace("ParseContext::next Stack invalid '{}'", escape_string(stack()));
+        final->call(_args.data());
+        return ParseStatus::Dispatched;
+    }
+    return ParseStatus::Pending;
+}
+
+escparse::ParseStatus escparse::ParseContext::fail(char chr)
+{
+    _invalid_stack = true;
+    if (_state == 0) {
+        ++_stats.ignored;
+        return ParseStatus::Ignored;
+    }
+
+    ++_stats.errors;
+    if (Log->should_log(spdlog::level::debug))
+        log_failure(_states[_state].rule, chr);
+    _state = 0;
+    if (uint8_t(chr) < 0x20 or uint8_t(chr) >= 0x7F)
+        return ParseStatus::Unconsumed;
+    _discard = (0x20 <= chr and chr < 0x40);
+    return ParseStatus::Error;
+}
+
+void escparse::ParseContext::log_failure(const BaseContainerRule* rule, char chr) const
+{
+    std::string avail;
+    for (auto child : rule->child_rules()) {
+        auto info = (child->type() == RuleType::Container
+                     ? static_cast<const BaseContainerRule*>(child)->chr()
+                     : static_cast<const BaseFinalRule*>(child)->info());
+        avail += info + ", ";
+    }
+    if (not avail.empty())
+        avail.erase(avail.end() - 2, avail.end());
+    Log->debug("Can't find rule by chr '{}', available: {}, stack: '{}'. skip.",
+               escape_string(std::string_view(&chr, 1)), avail, escape_string(stack()));
+}
@@ -0,0 +1,230 @@
+#include "escapewriter.hpp"
+
+#include <bit>
+
+
+
+namespace
+{
+
+
+/// Meta as SGR sees it, palette colors are bytes
+template<typename Color>
+struct SgrMeta
+{
+    Color background;
+    Color foreground;
+    uint16_t styles;
+};
+
+SgrMeta<uint8_t> sgr_meta(const CharUnit::Meta& meta)
+{
+    return {meta.background.term_color, meta.foreground.term_color, uint16_t(meta.styles & ascii_styles_mask)};
+}
+
+SgrMeta<TrueColor> sgr_meta(const WideCell::Meta& meta)
+{
+    return {meta.background, meta.foreground, uint16_t(meta.styles & ascii_styles_mask)};
+}
+
+const EscapeFragment& palette_param(uint8_t index, bool foreground)
+{
+    return foreground ? escape_foregrounds[index] : escape_backgrounds[index];
+}
+
+bool is_default(uint8_t color, bool foreground)
+{
+    return color == (foreground ? 15 : 0);
+}
+
+bool is_default(TrueColor color, bool foreground)
+{
+    return color == TrueColor::indexed(foreground ? 15 : 0);
+}
+
+size_t color_len(uint8_t color, bool foreground)
+{
+    return palette_param(color, foreground).len;
+}
+
+/// "38;2;r;g;b" or "48;2;r;g;b" for 24-bit colors
+size_t color_len(TrueColor color, bool foreground)
+{
+    if (not color.is_rgb())
+        return color_len(color.index(), foreground);
+    return 5 + escape_numbers[color.red()].len + 1 + escape_numbers[color.green()].len + 1
+            + escape_numbers[color.blue()].len;
+}
+
+void put_color(EscapeWriter& out, uint8_t color, bool foreground)
+{
+    out.put(palette_param(color, foreground));
+}
+
+void put_color(EscapeWriter& out, TrueColor color, bool foreground)
+{
+    if (not color.is_rgb())
+        return put_color(out, color.index(), foreground);
+    out.put(foreground ? "38;2;" : "48;2;", 5);
+    out.put(escape_numbers[color.red()]);
+    out.put(';');
+    out.put(escape_numbers[color.green()]);
+    out.put(';');
+    out.put(escape_numbers[color.blue()]);
+}
+
+
+/// Parameters of the shorter SGR route and its exact length
+struct SgrPlan
+{
+    size_t len = 0;         //< Bytes including "\e[" and 'm', 0 when nothing changes
+    bool reset = false;
+    uint16_t disable = 0;
+    uint16_t enable = 0;
+    bool fg = false;
+    bool bg = false;
+};
+
+size_t enable_len(uint16_t styles)
+{
+    size_t len = 0;
+    for (uint16_t bits = styles; bits; bits &= bits - 1)
+        len += escape_numbers[static_cast<int>(ascii_styles[std::countr_zero(bits)].enable)].len + 1;
+    return len;
+}
+
+template<typename Color>
+SgrPlan plan_sgr(const SgrMeta<Color>& next, const SgrMeta<Color>& prev)
+{
+    SgrPlan plan;
+    plan.fg = not (next.foreground == prev.foreground);
+    plan.bg = not (next.background == prev.background);
+    if (not plan.fg and not plan.bg and next.styles == prev.styles)
+        return plan;
+
+    // Incremental route: disable codes may switch off whole groups,
+    // styles that must stay are enabled again
+    plan.disable = prev.styles & ~next.styles;
+    uint16_t cleared = 0;
+    size_t inc_len = 0;
+    for (uint16_t bits = plan.disable; bits; bits &= bits - 1) {
+        auto i = std::countr_zero(bits);
+        if (not (cleared & (1 << i))) {
+            cleared |= ascii_styles_cleared[i];
+            inc_len += escape_numbers[static_cast<int>(ascii_styles[i].disable)].len + 1;
+        }
+    }
+    plan.enable = next.styles & ~(prev.styles & ~cleared);
+
+    inc_len += enable_len(plan.enable);
+    if (plan.fg)
+        inc_len += color_len(next.foreground, true) + 1;
+    if (plan.bg)
+        inc_len += color_len(next.background, false) + 1;
+    if (inc_len == 0)
+        return plan;
+
+    // Reset route: "0" and everything that differs from the default pen
+    bool reset_fg = not is_default(next.foreground, true);
+    bool reset_bg = not is_default(next.background, false);
+    size_t reset_len = 2 + enable_len(next.styles);
+    if (reset_fg)
+        reset_len += color_len(next.foreground, true) + 1;
+    if (reset_bg)
+        reset_len += color_len(next.background, false) + 1;
+
+    if (reset_len < inc_len) {
+        plan.reset = true;
+        plan.disable = 0;
+        plan.enable = next.styles;
+        plan.fg = reset_fg;
+        plan.bg = reset_bg;
+    }
+    // "\e[" plus the parameters, the last separator becomes 'm'
+    plan.len = 2 + std::min(inc_len, reset_len);
+    return plan;
+}
+
+template<typename Color>
+void write_sgr(EscapeWriter& out, const SgrMeta<Color>& next, const SgrPlan& plan)
+{
+    if (plan.len == 0)
+        return;
+
+    out.reserve(plan.len);
+    out.put("\e[", 2);
+    if (plan.reset)
+        out.put("0;", 2);
+    uint16_t cleared = 0;
+    for (uint16_t bits = plan.disable; bits; bits &= bits - 1) {
+        auto i = std::countr_zero(bits);
+        if (not (cleared & (1 << i))) {
+            cleared |= ascii_styles_cleared[i];
+            out.put(escape_numbers[static_cast<int>(ascii_styles[i].disable)]);
+            out.put(';');
+        }
+    }
+    for (uint16_t bits = plan.enable; bits; bits &= bits - 1) {
+        out.put(escape_numbers[static_cast<int>(ascii_styles[std::countr_zero(bits)].enable)]);
+        out.put(';');
+    }
+    if (plan.fg) {
+        put_color(out, next.foreground, true);
+        out.put(';');
+    }
+    if (plan.bg) {
+        put_color(out, next.background, false);
+        out.put(';');
+    }
+    // Last separator becomes the final byte
+    out.back() = 'm';
+}
+
+
+}
+
+
+
+unsigned sgr_escape_cost(const CharUnit::Meta& next, const CharUnit::Meta& prev)
+{
+    return static_cast<unsigned>(plan_sgr(sgr_meta(next), sgr_meta(prev)).len);
+}
+
+unsigned sgr_escape_cost(const WideCell::Meta& next, const WideCell::Meta& prev)
+{
+    return static_cast<unsigned>(plan_sgr(sgr_meta(next), sgr_meta(prev)).len);
+}
+
+void EscapeWriter::sgr(const CharUnit::Meta& next, const CharUnit::Meta& prev)
+{
+    auto meta = sgr_meta(next);
+    write_sgr(*this, meta, plan_sgr(meta, sgr_meta(prev)));
+}
+
+void EscapeWriter::sgr(const WideCell::Meta& next, const WideCell::Meta& prev)
+{
+    auto meta = sgr_meta(next);
+    write_sgr(*this, meta, plan_sgr(meta, sgr_meta(prev)));
+}
+
+void EscapeWriter::utf8(char32_t code)
+{
+    reserve(4);
+    if (code < 0x80)
+        put(char(code));
+    else if (code < 0x800) {
+        put(char(0xC0 | code >> 6));
+        put(char(0x80 | (code & 0x3F)));
+    }
+    else if (code < 0x10000) {
+        put(char(0xE0 | code >> 12));
+        put(char(0x80 | (code >> 6 & 0x3F)));
+        put(char(0x80 | (code & 0x3F)));
+    }
+    else {
+        put(char(0xF0 | code >> 18));
+        put(char(0x80 | (code >> 12 & 0x3F)));
+        put(char(0x80 | (code >> 6 & 0x3F)));
+        put(char(0x80 | (code & 0x3F)));
+    }
+}
@@ -0,0 +1,215 @@
+#include "inputscan.hpp"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INPUTSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+
+
+namespace
+{
+
+
+bool is_control(char chr)
+{
+    auto byte = uint8_t(chr);
+    return byte < 0x20 or byte == 0x7F;
+}
+
+size_t text_run_scalar(const char* bytes, size_t count)
+{
+    size_t i = 0;
+    while (i < count and not is_control(bytes[i]))
+        i++;
+    return i;
+}
+
+size_t ascii_run_scalar(const char* bytes, size_t count)
+{
+    size_t i = 0;
+    while (i < count and uint8_t(bytes[i]) < 0x80)
+        i++;
+    return i;
+}
+
+
+#ifdef INPUTSCAN_X86
+
+// SSE2
+
+__attribute__((target("sse2")))
+size_t text_run_sse2(const char* bytes, size_t count)
+{
+    const auto below = _mm_set1_epi8(0x1F);
+    const auto del = _mm_set1_epi8(0x7F);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        // Unsigned v <= 0x1F as min(v, 0x1F) == v
+        auto control = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, below), v), _mm_cmpeq_epi8(v, del));
+        if (auto mask = uint32_t(_mm_movemask_epi8(control)))
+            return i + std::countr_zero(mask);
+    }
+    return i + text_run_scalar(bytes + i, count - i);
+}
+
+__attribute__((target("sse2")))
+size_t ascii_run_sse2(const char* bytes, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        // The top bit of every byte
+        if (auto mask = uint32_t(_mm_movemask_epi8(v)))
+            return i + std::countr_zero(mask);
+    }
+    return i + ascii_run_scalar(bytes + i, count - i);
+}
+
+
+// AVX2
+
+__attribute__((target("avx2")))
+size_t text_run_avx2(const char* bytes, size_t count)
+{
+    const auto below = _mm256_set1_epi8(0x1F);
+    const auto del = _mm256_set1_epi8(0x7F);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+        auto control = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, below), v), _mm256_cmpeq_epi8(v, del));
+        if (auto mask = uint32_t(_mm256_movemask_epi8(control)))
+            return i + std::countr_zero(mask);
+    }
+    return i + text_run_sse2(bytes + i, count - i);
+}
+
+__attribute__((target("avx2")))
+size_t ascii_run_avx2(const char* bytes, size_t count)
+{
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+        if (auto mask = uint32_t(_mm256_movemask_epi8(v)))
+            return i + std::countr_zero(mask);
+    }
+    return i + ascii_run_sse2(bytes + i, count - i);
+}
+
+#endif
+
+
+struct Scans
+{
+    size_t (*text_run)(const char*, size_t);
+    size_t (*ascii_run)(const char*, size_t);
+};
+
+Scans select_scans()
+{
+    Scans scans{text_run_scalar, ascii_run_scalar};
+#ifdef INPUTSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        scans = {text_run_sse2, ascii_run_sse2};
+    if (__builtin_cpu_supports("avx2"))
+        scans = {text_run_avx2, ascii_run_avx2};
+#endif
+    return scans;
+}
+
+const Scans& scans()
+{
+    static const Scans selected = select_scans();
+    return selected;
+}
+
+
+bool valid_code(char32_t code, char32_t min)
+{
+    return code >= min and code <= 0x10FFFF and not (0xD800 <= code and code <= 0xDFFF);
+}
+
+
+}
+
+
+
+size_t inputscan::text_run(const char* bytes, size_t count)
+{
+    return scans().text_run(bytes, count);
+}
+
+size_t inputscan::ascii_run(const char* bytes, size_t count)
+{
+    return scans().ascii_run(bytes, count);
+}
+
+void inputscan::Utf8Decoder::decode(std::string_view bytes, std::u32string& out)
+{
+    // Every byte yields at most one code point, plus the replacement of a
+    // sequence the last read left open
+    size_t base = out.size();
+    out.resize(base + bytes.size() + 1);
+    char32_t* dst = out.data() + base;
+
+    size_t i = 0;
+    while (i < bytes.size()) {
+        if (_need == 0) {
+            auto ascii = ascii_run(bytes.data() + i, bytes.size() - i);
+            for (size_t k = 0; k < ascii; k++)
+                dst[k] = uint8_t(bytes[i + k]);
+            dst += ascii;
+            i += ascii;
+            if (i == bytes.size())
+                break;
+        }
+
+        auto byte = uint8_t(bytes[i]);
+        if (_need) {
+            if ((byte & 0xC0) != 0x80) {
+                // Truncated sequence, the byte is read again as a lead
+                *dst++ = U'\uFFFD';
+                _need = 0;
+                continue;
+            }
+            _code = _code << 6 | (byte & 0x3F);
+            i++;
+            if (--_need == 0)
+                *dst++ = valid_code(_code, _min) ? _code : U'\uFFFD';
+            continue;
+        }
+
+        i++;
+        if (0xC2 <= byte and byte < 0xE0) {
+            _code = byte & 0x1F;
+            _min = 0x80;
+            _need = 1;
+        }
+        else if (0xE0 <= byte and byte < 0xF0) {
+            _code = byte & 0x0F;
+            _min = 0x800;
+            _need = 2;
+        }
+        else if (0xF0 <= byte and byte < 0xF5) {
+            _code = byte & 0x07;
+            _min = 0x10000;
+            _need = 3;
+        }
+        else
+            *dst++ = U'\uFFFD';
+    }
+    out.resize(size_t(dst - out.data()));
+}
+
+void inputscan::Utf8Decoder::interrupt(std::u32string& out)
+{
+    if (_need) {
+        out.push_back(U'\uFFFD');
+        _need = 0;
+    }
+}
@@ -0,0 +1,370 @@
+#include "linemotion.hpp"
+#include "escapewriter.hpp"
+
+#include <algorithm>
+#include <vector>
+
+
+
+namespace
+{
+
+
+template<typename Cell>
+bool segment_same(const Cell* left_row, const Cell* right_row, unsigned left, unsigned right)
+{
+    for (unsigned x = left; x < right; x++)
+        if (not looks_same(left_row[x], right_row[x]))
+            return false;
+    return true;
+}
+
+unsigned count_of(int shift)
+{
+    return shift > 0 ? shift : -shift;
+}
+
+/// "\e[rH" to column 0 of row `y`
+unsigned row_jump_cost(unsigned y)
+{
+    return escape_csi_cost(y + 1);
+}
+
+unsigned region_length(const ScrollMotion& motion, Vector2u size)
+{
+    unsigned cost = 4 + escape_number_len(motion.top + 1) + escape_number_len(motion.bottom)
+            + escape_csi_cost(count_of(motion.shift)) + 3;
+    if (motion.left != 0 or motion.right != size.x)
+        cost += 6 + 4 + escape_number_len(motion.left + 1) + escape_number_len(motion.right) + 3 + 6;
+    return cost;
+}
+
+/// DL at the edge rows leave, IL at the edge new rows come in,
+/// either one is skipped at the bottom of the screen
+unsigned insert_delete_length(const ScrollMotion& motion, Vector2u size)
+{
+    unsigned count = count_of(motion.shift);
+    unsigned edge = motion.bottom - count;
+    unsigned cost = 0;
+    if (motion.shift > 0)
+        cost += row_jump_cost(motion.top) + escape_csi_cost(count);
+    if (motion.bottom < size.y)
+        cost += row_jump_cost(edge) + escape_csi_cost(count);
+    if (motion.shift < 0)
+        cost += row_jump_cost(motion.top) + escape_csi_cost(count);
+    return cost;
+}
+
+/// Picks the cheaper method for the motion, ~0u when the caps allow none
+unsigned pick_method(ScrollMotion& motion, Vector2u size, const TermCaps& caps)
+{
+    // DL/IL move whole rows only
+    unsigned length = ~0u;
+    if (caps.scroll_region) {
+        motion.method = ScrollMotion::Method::Region;
+        length = region_length(motion, size);
+    }
+    if (caps.insert_delete_line and motion.left == 0 and motion.right == size.x
+            and insert_delete_length(motion, size) < length) {
+        motion.method = ScrollMotion::Method::InsertDelete;
+        length = insert_delete_length(motion, size);
+    }
+    return length;
+}
+
+/// Cells of the segment that would be painted, at least a byte each
+template<typename Cell>
+int segment_diff(const Cell* left_row, const Cell* right_row, unsigned left, unsigned right)
+{
+    int count = 0;
+    for (unsigned x = left; x < right; x++)
+        count += not looks_same(left_row[x], right_row[x]);
+    return count;
+}
+
+
+}
+
+
+
+template<typename Policy>
+ScrollMotion ScrollMotion::plan(const BasicTextMap<Policy>& back, const BasicTextMap<Policy>& front,
+                                const TermCaps& caps)
+{
+    ScrollMotion best;
+    Vector2u size = back.size;
+    if (not (caps.scroll_region or caps.insert_delete_line) or size.y < 2 or size.x == 0)
+        return best;
+
+    // Whole-row hashes find changed rows in O(1) each
+    std::vector<uint64_t> back_hash(size.y), front_hash(size.y);
+    unsigned rows_changed = 0;
+    for (unsigned y = 0; y < size.y; y++) {
+        back_hash[y] = back.row_hash(y);
+        front_hash[y] = front.row_hash(y);
+        rows_changed += back_hash[y] != front_hash[y];
+    }
+    if (rows_changed < 2)
+        return best;
+
+    // With side margins only the changed columns are matched
+    unsigned left = 0, right = size.x;
+    if (caps.scroll_region and caps.lr_margins) {
+        left = size.x;
+        right = 0;
+        for (unsigned y = 0; y < size.y; y++) {
+            if (back_hash[y] == front_hash[y])
+                continue;
+            auto b = back.row_data(y);
+            auto f = front.row_data(y);
+            for (unsigned x = 0; x < size.x; x++) {
+                if (not looks_same(b[x], f[x])) {
+                    left = std::min(left, x);
+                    right = std::max(right, x + 1);
+                }
+            }
+        }
+        if (left != 0 or right != size.x) {
+            for (unsigned y = 0; y < size.y; y++) {
+                back_hash[y] = hash_cells(back.row_data(y) + left, right - left);
+                front_hash[y] = hash_cells(front.row_data(y) + left, right - left);
+            }
+        }
+    }
+
+    // Exposed rows are erased to the default background
+    std::vector<typename Policy::Cell> blank_row(right - left, Policy::none());
+    uint64_t blank_hash = hash_cells(blank_row.data(), blank_row.size());
+
+    // Every stretch of rows found `shift` rows away in the old frame, scored by
+    // the rows it fixes minus the matching rows its exposed edge destroys
+    int best_saved = 0;
+    unsigned best_first = 0, best_last = 0;
+    for (int shift = 1 - int(size.y); shift < int(size.y); shift++) {
+        if (shift == 0)
+            continue;
+        unsigned count = count_of(shift);
+        unsigned first = 0;
+        int saved = 0;
+        bool inside = false;
+        for (unsigned y = 0; y <= size.y; y++) {
+            int source = int(y) + shift;
+            if (y < size.y and source >= 0 and source < int(size.y)
+                    and back_hash[y] == front_hash[source]) {
+                if (not inside)
+                    first = y;
+                inside = true;
+                saved += back_hash[y] != front_hash[y];
+                continue;
+            }
+            if (inside) {
+                unsigned exposed = shift > 0 ? y : first - count;
+                for (unsigned e = exposed; e < exposed + count; e++)
+                    saved -= int(back_hash[e] == front_hash[e]) - int(back_hash[e] == blank_hash);
+                if (saved > best_saved) {
+                    best_saved = saved;
+                    best_first = first;
+                    best_last = y;
+                    best.shift = shift;
+                }
+            }
+            inside = false;
+            saved = 0;
+        }
+    }
+    if (best.shift == 0)
+        return {};
+
+    best.left = left;
+    best.right = right;
+    best.top = best.shift > 0 ? best_first : best_first + best.shift;
+    best.bottom = best.shift > 0 ? best_last + best.shift : best_last;
+
+    // Cheapest way to send it
+    unsigned length = pick_method(best, size, caps);
+    // The cursor is moved away, the next cell usually needs a jump
+    if (unsigned(best_saved) * (right - left) <= length + 4)
+        return {};
+
+    // Hashes only proposed the match
+    for (unsigned y = best_first; y < best_last; y++)
+        if (not segment_same(back.row_data(y), front.row_data(y + best.shift), left, right))
+            return {};
+    return best;
+}
+
+template<typename Policy>
+ScrollMotion ScrollMotion::plan(const BasicTextMap<Policy>& back, const BasicTextMap<Policy>& front,
+                                const ViewScroll& hint, const TermCaps& caps)
+{
+    Vector2u size = back.size;
+    Rect2u rect = hint.rect.clipped({{0, 0}, size});
+    unsigned count = count_of(hint.shift);
+    if (count == 0 or count >= rect.size.y)
+        return {};
+
+    // Cells left to paint without the shift minus cells left with it and
+    // the bytes it costs, exposed rows come in blank
+    std::vector<typename Policy::Cell> blank_row(size.x, Policy::none());
+    auto net = [&](ScrollMotion& motion) {
+        unsigned length = pick_method(motion, size, caps);
+        if (length == ~0u)
+            return 0;
+        int saved = -int(length + 4);
+        for (unsigned y = motion.top; y < motion.bottom; y++) {
+            int source = int(y) + motion.shift;
+            const auto* row = back.row_data(y);
+            saved += segment_diff(row, front.row_data(y), motion.left, motion.right);
+            saved -= source >= int(motion.top) and source < int(motion.bottom)
+                    ? segment_diff(row, front.row_data(source), motion.left, motion.right)
+                    : segment_diff(row, blank_row.data(), motion.left, motion.right);
+        }
+        return saved;
+    };
+
+    // Whole rows skip the side margins, which pays off when the rest of
+    // the rows moves along or is blank
+    ScrollMotion rows{rect.position.y, rect.end().y, 0, size.x, hint.shift};
+    int rows_net = net(rows);
+    ScrollMotion part{rect.position.y, rect.end().y, rect.position.x, rect.end().x, hint.shift};
+    int part_net = 0;
+    if (not (part.left == 0 and part.right == size.x) and caps.scroll_region and caps.lr_margins)
+        part_net = net(part);
+
+    if (rows_net <= 0 and part_net <= 0)
+        return {};
+    return rows_net >= part_net ? rows : part;
+}
+
+unsigned ScrollMotion::length(Vector2u size) const
+{
+    if (method == Method::InsertDelete)
+        return insert_delete_length(*this, size);
+    return region_length(*this, size);
+}
+
+void ScrollMotion::emit(EscapeWriter& out, Vector2u size) const
+{
+    unsigned count = count_of(shift);
+    out.reserve(length(size));
+    if (method == Method::InsertDelete) {
+        unsigned edge = bottom - count;
+        if (shift > 0) {
+            out.csi(top + 1, 'H');
+            out.csi(count, 'M');
+        }
+        if (bottom < size.y) {
+            out.csi(edge + 1, 'H');
+            out.csi(count, shift > 0 ? 'L' : 'M');
+        }
+        if (shift < 0) {
+            out.csi(top + 1, 'H');
+            out.csi(count, 'L');
+        }
+        return;
+    }
+
+    bool margins = left != 0 or right != size.x;
+    if (margins) {
+        out.put("\e[?69h", 6);
+        out.csi(left + 1, right, 's');
+    }
+    out.csi(top + 1, bottom, 'r');
+    out.csi(count, shift > 0 ? 'S' : 'T');
+    out.put("\e[r", 3);
+    if (margins) {
+        out.put("\e[s", 3);
+        out.put("\e[?69l", 6);
+    }
+}
+
+Vector2u ScrollMotion::cursor(Vector2u size) const
+{
+    if (method == Method::Region)
+        return {0, 0};
+    // Up shifts end at the IL edge unless it was the screen bottom
+    if (shift > 0 and bottom < size.y)
+        return {0, bottom - count_of(shift)};
+    return {0, top};
+}
+
+template<typename Policy>
+void ScrollMotion::apply(BasicTextMap<Policy>& frame, const typename Policy::Cell& blank) const
+{
+    frame.shift_rows({left, top}, {right, bottom}, shift, blank);
+}
+
+
+template<typename Policy>
+RectCopy RectCopy::plan(const BasicTextMap<Policy>& back, const BasicTextMap<Policy>& front,
+                        const ViewMove& hint, const TermCaps& caps)
+{
+    RectCopy copy{hint.from, hint.to, {0, 0}};
+    Vector2u screen = back.size;
+    if (not caps.rect_copy or not (hint.from < screen) or not (hint.to < screen))
+        return copy;
+    Vector2u size{
+        std::min({hint.size.x, screen.x - hint.from.x, screen.x - hint.to.x}),
+        std::min({hint.size.y, screen.y - hint.from.y, screen.y - hint.to.y}),
+    };
+
+    // Cells the copy fixes minus cells it breaks, each worth at least a byte
+    int saved = 0;
+    for (unsigned y = 0; y < size.y; y++) {
+        auto b = back.row_data(hint.to.y + y) + hint.to.x;
+        auto source = front.row_data(hint.from.y + y) + hint.from.x;
+        auto current = front.row_data(hint.to.y + y) + hint.to.x;
+        for (unsigned x = 0; x < size.x; x++)
+            saved += int(looks_same(b[x], source[x])) - int(looks_same(b[x], current[x]));
+    }
+    copy.size = size;
+    if (saved <= int(copy.length()))
+        copy.size = {0, 0};
+    return copy;
+}
+
+unsigned RectCopy::length() const
+{
+    return 2 + escape_number_len(from.y + 1) + 1 + escape_number_len(from.x + 1) + 1
+            + escape_number_len(from.y + size.y) + 1 + escape_number_len(from.x + size.x) + 2
+            + escape_number_len(to.y + 1) + 1 + escape_number_len(to.x + 1) + 2;
+}
+
+void RectCopy::emit(EscapeWriter& out) const
+{
+    out.reserve(length());
+    out.put("\e[", 2);
+    out.put_number(from.y + 1);
+    out.put(';');
+    out.put_number(from.x + 1);
+    out.put(';');
+    out.put_number(from.y + size.y);
+    out.put(';');
+    out.put_number(from.x + size.x);
+    out.put(";;", 2);
+    out.put_number(to.y + 1);
+    out.put(';');
+    out.put_number(to.x + 1);
+    out.put("$v", 2);
+}
+
+template<typename Policy>
+void RectCopy::apply(BasicTextMap<Policy>& frame) const
+{
+    frame.copy_rect(from, to, size);
+}
+
+
+#define LINEMOTION_INSTANTIATE(Policy) \
+    template ScrollMotion ScrollMotion::plan(const BasicTextMap<Policy>&, const BasicTextMap<Policy>&, \
+                                             const TermCaps&); \
+    template ScrollMotion ScrollMotion::plan(const BasicTextMap<Policy>&, const BasicTextMap<Policy>&, \
+                                             const ViewScroll&, const TermCaps&); \
+    template void ScrollMotion::apply(BasicTextMap<Policy>&, const Policy::Cell&) const; \
+    template RectCopy RectCopy::plan(const BasicTextMap<Policy>&, const BasicTextMap<Policy>&, \
+                                     const ViewMove&, const TermCaps&); \
+    template void RectCopy::apply(BasicTextMap<Policy>&) const;
+
+LINEMOTION_INSTANTIATE(StandardCellPolicy)
+LINEMOTION_INSTANTIATE(CompactCellPolicy)
+LINEMOTION_INSTANTIATE(WideCellPolicy)
@@ -0,0 +1,69 @@
+#include "ringtextmap.hpp"
+
+#include <algorithm>
+
+
+
+template<typename Policy>
+void BasicRingTextMap<Policy>::write_span(unsigned y, unsigned x, const CharUnit* cells, unsigned count)
+{
+    if (y >= size.y or x >= size.x)
+        return;
+    count = std::min(count, size.x - x);
+    if constexpr (std::is_same_v<Cell, CharUnit>)
+        std::copy_n(cells, count, row(y) + x);
+    else
+        std::transform(cells, cells + count, row(y) + x, [](const CharUnit& unit) { return Policy::from_unit(unit); });
+}
+
+template<typename Policy>
+void BasicRingTextMap<Policy>::fill_rect(Rect2u rect, const CharUnit& unit)
+{
+    rect = rect.clipped({{0, 0}, size});
+    Cell cell = Policy::from_unit(unit);
+    for (unsigned y = rect.position.y; y < rect.end().y; y++)
+        std::fill_n(row(y) + rect.position.x, rect.size.x, cell);
+}
+
+template<typename Policy>
+void BasicRingTextMap<Policy>::scroll(int count, const Cell& blank)
+{
+    if (count == 0 or size.y == 0)
+        return;
+    _scrolled += count;
+    unsigned rows = count > 0 ? count : -count;
+    if (rows >= size.y) {
+        std::fill(_map.begin(), _map.end(), blank);
+        return;
+    }
+    // Up: the old first rows become the last ones, down: the other way round
+    if (count > 0) {
+        _first = ring_row(rows);
+        for (unsigned y = size.y - rows; y < size.y; y++)
+            std::fill_n(row(y), size.x, blank);
+    }
+    else {
+        _first = ring_row(size.y - rows);
+        for (unsigned y = 0; y < rows; y++)
+            std::fill_n(row(y), size.x, blank);
+    }
+}
+
+template<typename Policy>
+void BasicRingTextMap<Policy>::resize(Vector2u size)
+{
+    if (size == this->size)
+        return;
+    std::vector<Cell> map(size.x * size.y, Policy::none());
+    Vector2u keep{std::min(size.x, this->size.x), std::min(size.y, this->size.y)};
+    for (unsigned y = 0; y < keep.y; y++)
+        std::copy_n(row_data(y), keep.x, &map[y * size.x]);
+    _map = std::move(map);
+    _first = 0;
+    this->size = size;
+}
+
+
+template class BasicRingTextMap<StandardCellPolicy>;
+template class BasicRingTextMap<CompactCellPolicy>;
+template class BasicRingTextMap<WideCellPolicy>;
@@ -0,0 +1,24 @@
+#include "termcaps.hpp"
+
+#include <cstdlib>
+#include <string_view>
+
+
+
+TermCaps TermCaps::from_env()
+{
+    TermCaps caps;
+    const char* env = std::getenv("TERM");
+    std::string_view term = env ? env : "";
+    if (term.empty() or term == "dumb") {
+        caps.erase_chars = false;
+        caps.erase_line = false;
+        caps.scroll_region = false;
+        caps.insert_delete_line = false;
+        caps.sync_output = false;
+        return caps;
+    }
+    // xterm and the terminals that claim to be one handle REP
+    caps.repeat = term.starts_with("xterm");
+    return caps;
+}
@@ -0,0 +1,20 @@
+#include "termoutput.hpp"
+
+#include <cerrno>
+#include <unistd.h>
+
+
+
+bool write_frame(int fd, std::string_view frame)
+{
+    while (not frame.empty()) {
+        auto written = ::write(fd, frame.data(), frame.size());
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        frame.remove_prefix(written);
+    }
+    return true;
+}
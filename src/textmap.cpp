@@ -1,125 +1,575 @@
 #include <textmap.hpp>
+#include <cellkernels.hpp>
+#include <cursormotion.hpp>
+#include <escapewriter.hpp>
+#include <linemotion.hpp>
 
 
 
-std::string rjump(Vector2i off)
+/// Longest gap worth re-emitting instead of a cursor jump
+constexpr unsigned max_reprint_gap = 16;
+
+/// Cell shows the same when printed with `pen`
+template<typename Policy>
+static bool prints_as(const typename Policy::Cell& unit, const typename Policy::Meta& pen)
 {
-    std::string result;
-    if (off.x)
-        result += "\033[" + std::to_string(abs(off.x)) + "CD"[off.x < 0];
-    if (off.y)
-        result += "\033[" + std::to_string(abs(off.y)) + "BA"[off.y < 0];
-    return result;
+    if (unit.meta == pen)
+        return true;
+    return is_blank(unit) and Policy::blank_meta(unit.meta, pen) == pen;
 }
 
-std::string jump(Vector2i off)
+/// Meta a reprinted cell needs, blank cells keep the pen foreground
+template<typename Policy>
+static typename Policy::Meta reprint_meta(const typename Policy::Cell& unit, const typename Policy::Meta& pen)
 {
-    std::string result;
-    if (off.x)
-        result += "\033[" + std::to_string(abs(off.x)) + "CD"[off.x < 0];
-    if (off.y)
-        result += "\033[" + std::to_string(abs(off.y)) + "BA"[off.y < 0];
-    return result;
+    if (prints_as<Policy>(unit, pen))
+        return pen;
+    if (is_blank(unit))
+        return Policy::blank_meta(unit.meta, pen);
+    return unit.meta;
+}
+
+template<typename Policy>
+unsigned BasicSTDIOTextArea<Policy>::move_pen(EscapeWriter& out, Pen& pen, Vector2u to,
+                                              const Cell* row, const Meta& target) const
+{
+    if (pen.cursor == to)
+        return 0;
+
+    // Cells between the cursor and the target may be printed again with their SGR,
+    // which also changes the SGR needed for the target
+    unsigned reprint = cursor_unknown;
+    if (pen.cursor.y == to.y and pen.cursor.x < to.x and to.x - pen.cursor.x <= max_reprint_gap) {
+        Meta meta = pen.meta;
+        unsigned bytes = 0;
+        for (unsigned x = pen.cursor.x; x < to.x; x++) {
+            auto next = reprint_meta<Policy>(row[x], meta);
+            bytes += _sgr_cache.cost(next, meta) + Policy::glyph_length(row[x]);
+            meta = next;
+        }
+        bytes += _sgr_cache.cost(target, meta);
+        unsigned direct = _sgr_cache.cost(target, pen.meta);
+        reprint = bytes > direct ? bytes - direct : 0;
+    }
+
+    auto motion = CursorMotion::plan(pen.cursor, to, reprint);
+    unsigned written = 0;
+    if (motion.horizontal == CursorMotion::Horizontal::Reprint) {
+        for (unsigned x = pen.cursor.x; x < to.x; x++) {
+            auto next = reprint_meta<Policy>(row[x], pen.meta);
+            written += _sgr_cache.cost(next, pen.meta) + Policy::glyph_length(row[x]);
+            _sgr_cache.encode(out, next, pen.meta);
+            Policy::glyph(out, row[x]);
+            pen.meta = next;
+        }
+    }
+    else {
+        written = motion.length(pen.cursor, to);
+        out.reserve(written);
+        motion.emit(out, pen.cursor, to);
+    }
+    pen.cursor = to;
+    return written;
 }
 
-void to_aixterm_escape_jump(EscapeSequence& seq, int x, int y)
+/// Cursor after a glyph at `pos`, the last column leaves it in pending wrap
+static Vector2u advance_cursor(Vector2u pos, unsigned width)
 {
-    // Generate escape sequence to move the cursor to the desired position (x, y)
-    seq.push_back(encode_char(L'\e')); // ESC character
-    seq.push_back(encode_char(L'['));
-    seq.push_back(encode_number(y + 1)); // Rows are 1-based
-    seq.push_back(encode_char(L';'));
-    seq.push_back(encode_number(x + 1)); // Columns are 1-based
-    seq.push_back(encode_char(L'H')); // Command to move cursor
+    return {pos.x + 1 < width ? pos.x + 1 : cursor_unknown, pos.y};
 }
 
-std::string encode_utf8(wchar_t ch)
+/// First column past the cells from `x` that look like row[x]
+template<typename Cell>
+static unsigned find_run_end(const Cell* row, unsigned x, unsigned width)
 {
-    if (ch > (wchar_t)127)
-        return {L'?'};
-    return {(char)ch};
+    unsigned end = x + 1;
+    if (is_blank(row[x])) {
+        while (end < width and looks_same(row[end], row[x]))
+            end++;
+    }
+    else {
+        while (end < width and row[end] == row[x])
+            end++;
+    }
+    return end;
+}
+
+template<typename Policy>
+unsigned BasicSTDIOTextArea<Policy>::paint_run(EscapeWriter& out, Pen& pen, const Cell* row,
+                                               Vector2u pos, unsigned count, unsigned run_end) const
+{
+    enum class Form { Glyph, Repeat, EraseChars, EraseLine } form = Form::Glyph;
+    const Cell& unit = row[pos.x];
+    unsigned glyph = Policy::glyph_length(unit);
+    unsigned best = count * glyph;
+    bool blank = is_blank(unit);
+
+    if (caps.repeat and count > 1 and Policy::repeatable(unit)
+            and glyph + escape_csi_cost(count - 1) < best) {
+        form = Form::Repeat;
+        best = glyph + escape_csi_cost(count - 1);
+    }
+    if (blank) {
+        // ECH leaves the cursor in place, the next cell is usually right after the run
+        if (caps.erase_chars and 2 * escape_csi_cost(count) < best) {
+            form = Form::EraseChars;
+            best = 2 * escape_csi_cost(count);
+        }
+        if (caps.erase_line and run_end == size.x and 3 < best) {
+            form = Form::EraseLine;
+            best = 3;
+        }
+    }
+
+    // Blank cells need the background only, the foreground is invisible
+    Meta target = blank ? Policy::blank_meta(unit.meta, pen.meta) : unit.meta;
+
+    pen.bytes += move_pen(out, pen, pos, row, target);
+
+    // Exact size of the step, the writes below never grow the buffer again
+    unsigned bytes = _sgr_cache.cost(target, pen.meta);
+    switch (form) {
+    case Form::Glyph: bytes += glyph; break;
+    case Form::Repeat: bytes += glyph + escape_csi_cost(count - 1); break;
+    case Form::EraseChars: bytes += escape_csi_cost(count); break;
+    case Form::EraseLine: bytes += 3; break;
+    }
+    out.reserve(bytes);
+    pen.bytes += bytes;
+
+    _sgr_cache.encode(out, target, pen.meta);
+    pen.meta = target;
+
+    switch (form) {
+    case Form::Glyph:
+        Policy::glyph(out, unit);
+        pen.cursor = advance_cursor(pos, size.x);
+        return 1;
+    case Form::Repeat:
+        Policy::glyph(out, unit);
+        out.csi(count - 1, 'b');
+        pen.cursor = advance_cursor({pos.x + count - 1, pos.y}, size.x);
+        return count;
+    case Form::EraseChars:
+        out.csi(count, 'X');
+        return count;
+    case Form::EraseLine:
+        out.csi(1, 'K');
+        return size.x - pos.x;
+    }
+    return 0;
 }
 
-std::string STDIOTextArea::print(std::string&& old) const
+template<typename Policy>
+std::string BasicSTDIOTextArea<Policy>::print(std::string&& old) const
 {
     std::string result = std::move(old);
-    auto [bytes_len, arg_cnt] = aixterm_escape_cost(CharUnit{ L'\0', { { CharColor256Bg{0} }, CharColor256Fg{64}, 3 } });
-    EscapeSequence sequence; // Estimate average length
-    sequence.reserve(arg_cnt * size.x * size.y);
-    if (result.size() == 0)
-        result.reserve(bytes_len * size.x * size.y * 1.15); // Reserve memory to avoid frequent reallocations
-
-    Vector2u last_pos{0, 0};
-    CharUnit last_unit = CharUnit::none; // Track the last rendered character unit
-    sequence.push_back(encode_char(L'\e'));
-    sequence.push_back(encode_char(L'['));
-    sequence.push_back(encode_char(L'0'));
-    sequence.push_back(encode_char(L'm'));
+    EscapeWriter out(result);
+    auto start = out.size();
+
+    Pen pen{{cursor_unknown, cursor_unknown}, Policy::none().meta, 4};
+    out.reserve(size.x * size.y + 4);
+    out.reset();
 
     for (unsigned int y = 0; y < size.y; ++y) {
-        for (unsigned int x = 0; x < size.x; ++x) {
-            CharUnit unit = _map[y * size.x + x];
+        const Cell* row = &_map[y * size.x];
+        unsigned run_end = 0;
+        for (unsigned int x = 0; x < size.x; ) {
+            if (x >= run_end)
+                run_end = find_run_end(row, x, size.x);
+            x += paint_run(out, pen, row, {x, y}, run_end - x, run_end);
+        }
+    }
 
-            // Handle empty characters with defined background
-            if (unit.character == L'\0') {
-                unit.character = L' '; // Replace with a space for rendering
-            }
+    _render_stats.add(pen.bytes, out.size() - start);
+    out.finish();
+    return result;
+}
 
-            // Handle character position jump if needed
-            if (x != last_pos.x || y != last_pos.y) {
-                to_aixterm_escape_jump(sequence, x, y);
+template<typename Policy>
+std::string BasicSTDIOTextArea<Policy>::print_diff(std::string&& old)
+{
+    if (not _front_valid or not (_front.size == size)) {
+        _moves.clear();
+        _scrolls.clear();
+        _damaged_rows.clear();
+        _damaged_count = 0;
+        auto result = print(std::move(old));
+        _front = *this;
+        _front_valid = true;
+        return result;
+    }
+
+    std::string result = std::move(old);
+    EscapeWriter out(result);
+    auto start = out.size();
+    size_t changed = 0;
+
+    // Cursor position is unknown after the previous frame, first run always jumps
+    Pen pen{{cursor_unknown, cursor_unknown}, Policy::none().meta, 0};
+    _diff_masks.resize(cellkernels::mask_words(size.x));
+
+    // Every write marks its rows, unmarked rows are as presented. Rows
+    // shifted or copied on the terminal are diffed too.
+    bool damaged_only = not _damaged_rows.empty();
+
+    // Moved views are copied by the terminal
+    for (auto& hint : _moves) {
+        auto copy = RectCopy::plan(*this, _front, hint, caps);
+        if (not copy)
+            continue;
+        if (changed++ == 0) {
+            out.reset();
+            pen.bytes += 4;
+        }
+        copy.emit(out);
+        pen.bytes += copy.length();
+        copy.apply(_front);
+        if (damaged_only)
+            damage_rows(copy.to.y, copy.to.y + copy.size.y);
+    }
+    _moves.clear();
+
+    // Scrolled views are shifted by the terminal as reported, other moved
+    // rows one hunk at a time, exposed ones are painted below
+    for (auto& hint : _scrolls) {
+        auto scroll = ScrollMotion::plan(*this, _front, hint, caps);
+        if (not scroll)
+            continue;
+        if (changed++ == 0) {
+            out.reset();
+            pen.bytes += 4;
+        }
+        scroll_front(out, pen, scroll);
+    }
+    _scrolls.clear();
+
+    // Unmarked rows were not written, a shift needs two changed rows
+    unsigned hunks = damaged_only and _damaged_count < 2 ? 0 : size.y;
+    for (unsigned hunk = 0; hunk < hunks; hunk++) {
+        auto scroll = ScrollMotion::plan(*this, _front, caps);
+        if (not scroll)
+            break;
+        if (changed++ == 0) {
+            out.reset();
+            pen.bytes += 4;
+        }
+        scroll_front(out, pen, scroll);
+    }
+
+    for (unsigned int y = 0; y < size.y; ++y) {
+        if (damaged_only and not _damaged_rows[y])
+            continue;
+        const Cell* back = &_map[y * size.x];
+        Cell* front = &_front._map[y * size.x];
+        // Bytewise equal cells are skipped 32 at a time. Equal row hashes
+        // may collide, the compare is what tells a row unchanged.
+        cellkernels::diff_masks(back, front, size.x, _diff_masks.data());
+        auto next_changed = [&](unsigned from) {
+            return unsigned(cellkernels::next_set(_diff_masks.data(), from, size.x));
+        };
+        unsigned run_end = 0, run_last = 0;
+        for (unsigned int x = next_changed(0); x < size.x; ) {
+            if (looks_same(back[x], front[x])) {
+                front[x] = back[x];
+                x = next_changed(x + 1);
+                continue;
             }
 
-            // Call to_aixterm_escape for handling style/color changes
-            to_aixterm_escape(sequence, unit, last_unit);
-            last_unit = unit;
+            if (changed++ == 0) {
+                out.reset();
+                pen.bytes += 4;
+            }
 
-            // Update last position
-            last_pos = {x + 1, y};
+            // Only the changed part of a run is painted, up to its last changed cell
+            if (x >= run_end) {
+                run_end = find_run_end(back, x, size.x);
+                run_last = x;
+                for (unsigned i = x + 1; i < run_end; i++)
+                    if (not looks_same(back[i], front[i]))
+                        run_last = i;
+            }
+            unsigned painted = paint_run(out, pen, back, {x, y}, run_last + 1 - x, run_end);
+            std::copy_n(back + x, painted, front + x);
+            x = next_changed(x + painted);
         }
+        _front._row_hash[y] = this->row_hash(y);
     }
 
-    // Encode all accumulated escape sequences at the end
-    result.resize(result.capacity());
-    result.resize(sequence.encode_all(result.data(), result.size()));
+    _damaged_rows.clear();
+    _damaged_count = 0;
+
+    _render_stats.add(pen.bytes, out.size() - start);
+    out.finish();
+    return result;
+}
+
+template<typename Policy>
+void BasicSTDIOTextArea<Policy>::scroll_front(EscapeWriter& out, Pen& pen, const ScrollMotion& scroll)
+{
+    scroll.emit(out, size);
+    pen.bytes += scroll.length(size);
+    pen.cursor = scroll.cursor(size);
+    // Exposed cells get the current background
+    Cell blank = Policy::none();
+    blank.meta = pen.meta;
+    scroll.apply(_front, blank);
+    if (not _damaged_rows.empty())
+        damage_rows(scroll.top, scroll.bottom);
+}
 
+template<typename Policy>
+std::string BasicSTDIOTextArea<Policy>::print_frame(std::string&& old)
+{
+    std::string result = std::move(old);
+    auto start = result.size();
+    if (caps.sync_output)
+        result.append("\e[?2026h", 8);
+    auto body = result.size();
+    result = print_diff(std::move(result));
+    if (result.size() == body)
+        result.resize(start);
+    else if (caps.sync_output)
+        result.append("\e[?2026l", 8);
     return result;
 }
 
-TextMap TextMap::create_from(const std::string& tex)
+template<typename Policy>
+void BasicSTDIOTextArea<Policy>::invalidate()
 {
-    TextMap map{{240, 120}};
+    _front_valid = false;
+}
+
+template<typename Policy>
+void BasicSTDIOTextArea<Policy>::hint_move(Vector2u from, Vector2u to, Vector2u size)
+{
+    // A view dragged several times between frames moves once
+    if (not _moves.empty() and _moves.back().to == from and _moves.back().size == size)
+        _moves.back().to = to;
+    else
+        _moves.push_back({from, to, size});
+}
+
+template<typename Policy>
+void BasicSTDIOTextArea<Policy>::hint_scroll(Rect2u rect, int shift)
+{
+    // Lines added to a log between frames scroll once
+    if (not _scrolls.empty() and _scrolls.back().rect.position == rect.position
+            and _scrolls.back().rect.size == rect.size)
+        _scrolls.back().shift += shift;
+    else
+        _scrolls.push_back({rect, shift});
+}
+
+template<typename Policy>
+void BasicSTDIOTextArea<Policy>::hint_damage(Rect2u rect)
+{
+    rect = rect.clipped({{0, 0}, size});
+    if (not rect.empty())
+        damage_rows(rect.position.y, rect.end().y);
+}
+
+template<typename Policy>
+BasicTextMap<Policy> BasicTextMap<Policy>::create_from(const std::string& tex)
+{
+    BasicTextMap map{{240, 120}};
     ::draw(&map, {0, 0}, tex);
     return map.strip();
 }
 
-void TextMap::load_from(const std::string& tex)
+template<typename Policy>
+void BasicTextMap<Policy>::load_from(const std::string& tex)
 {
-    TextMap map{{240, 120}};
+    BasicTextMap map{{240, 120}};
     ::draw(&map, {0, 0}, tex);
     *this = map.strip();
 }
 
-void TextMap::resize(Vector2u size)
+template<typename Policy>
+void BasicTextMap<Policy>::resize(Vector2u size, bool reflow)
 {
-    std::vector<CharUnit> new_area(size.x * size.y, CharUnit{});
-    for (size_t y = 0; y < std::min<size_t>(size.y, this->size.y); y++) {
-        for (size_t x = 0; x < std::min<size_t>(size.x, this->size.x); x++) {
-            new_area[x + y * size.y] = std::move(_map[x + y * this->size.y]);
+    Vector2u old = this->size;
+    if (size == old)
+        return;
+    if (reflow and size.x != old.x and size.x != 0 and old.x != 0)
+        return reflow_to(size);
+
+    // Growth keeps some slack, a terminal dragged wider grows a column at a time
+    size_t cells = size_t(size.x) * size.y;
+    if (cells > _map.capacity())
+        _map.reserve(cells + cells / 4);
+
+    const Cell& none = Policy::none();
+    unsigned keep_y = std::min(size.y, old.y);
+    if (size.x <= old.x) {
+        // Narrower rows move to the front, the first row stays in place
+        for (unsigned y = 1; y < keep_y; y++)
+            std::copy_n(&_map[y * old.x], size.x, &_map[y * size.x]);
+        _map.resize(cells, none);
+    }
+    else {
+        // Wider rows move to the back, the last row goes first
+        _map.resize(std::max(cells, _map.size()), none);
+        for (unsigned y = keep_y; y-- > 0; ) {
+            auto row = &_map[y * old.x];
+            if (y != 0)
+                std::copy_backward(row, row + old.x, &_map[y * size.x + old.x]);
+            std::fill_n(&_map[y * size.x + old.x], size.x - old.x, none);
         }
+        _map.resize(cells);
     }
-    _map = new_area;
+    std::fill(_map.begin() + size_t(keep_y) * size.x, _map.end(), none);
+
     this->size = size;
+    // A new size is diffed against nothing, the renderer repaints it whole
+    _damaged_rows.clear();
+    _damaged_count = 0;
+    // Rows of the same width keep their hash
+    if (size.x == old.x)
+        _row_hash.resize(size.y, stale_hash);
+    else
+        _row_hash.assign(size.y, stale_hash);
 }
 
-TextMap TextMap::strip() const
+template<typename Policy>
+void BasicTextMap<Policy>::reflow_to(Vector2u size)
+{
+    Vector2u old = this->size;
+    const Cell& none = Policy::none();
+    // Logical lines are rows that end in a used last cell and the row after them
+    _scratch.assign(_map.begin(), _map.end());
+    auto used = [&](unsigned y) {
+        const Cell* row = &_scratch[y * old.x];
+        unsigned len = old.x;
+        while (len > 0 and looks_same(row[len - 1], none))
+            len--;
+        return len;
+    };
+    auto for_each_line = [&](auto&& line) {
+        for (unsigned y = 0; y < old.y; ) {
+            unsigned first = y, len = 0;
+            while (y + 1 < old.y and used(y) == old.x)
+                len += old.x, y++;
+            len += used(y++);
+            line(&_scratch[first * old.x], len);
+        }
+    };
+
+    // Rows the rewrapped lines take, trailing empty lines don't count,
+    // lines that no longer fit are dropped from the top
+    unsigned rows = 0, content = 0;
+    for_each_line([&](const Cell*, unsigned len) {
+        rows += std::max(1u, (len + size.x - 1) / size.x);
+        if (len != 0)
+            content = rows;
+    });
+    unsigned skip = content > size.y ? content - size.y : 0;
+
+    size_t cells = size_t(size.x) * size.y;
+    if (cells > _map.capacity())
+        _map.reserve(cells + cells / 4);
+    _map.assign(cells, none);
+
+    unsigned row = 0;
+    for_each_line([&](const Cell* line, unsigned len) {
+        unsigned count = std::max(1u, (len + size.x - 1) / size.x);
+        for (unsigned i = 0; i < count; i++, row++) {
+            if (row < skip or row - skip >= size.y)
+                continue;
+            unsigned begin = i * size.x;
+            unsigned width = std::min(size.x, len - std::min(len, begin));
+            std::copy_n(line + begin, width, &_map[(row - skip) * size.x]);
+        }
+    });
+
+    // Emptied but not released, copies of the map stay cheap
+    _scratch.clear();
+    this->size = size;
+    _row_hash.assign(size.y, stale_hash);
+    _damaged_rows.clear();
+    _damaged_count = 0;
+}
+
+template<typename Policy>
+void BasicTextMap<Policy>::fill_cells(Rect2u rect, const Cell& cell)
+{
+    rect = rect.clipped({{0, 0}, size});
+    for (unsigned y = rect.position.y; y < rect.end().y; y++) {
+        std::fill_n(&_map[y * size.x + rect.position.x], rect.size.x, cell);
+    }
+    touch_rows(rect.position.y, rect.end().y);
+}
+
+template<typename Policy>
+uint64_t BasicTextMap<Policy>::row_hash(unsigned y) const
+{
+    auto& hash = _row_hash[y];
+    if (hash == stale_hash)
+        hash = hash_cells(row_data(y), size.x);
+    return hash;
+}
+
+template<typename Policy>
+void BasicTextMap<Policy>::copy_rect(Vector2u from, Vector2u to, Vector2u size)
+{
+    auto row = [&](Vector2u corner, unsigned y) { return &_map[(corner.y + y) * this->size.x + corner.x]; };
+    auto copy_row = [&](unsigned y) {
+        auto src = row(from, y);
+        if (to.x > from.x)
+            std::copy_backward(src, src + size.x, row(to, y) + size.x);
+        else
+            std::copy(src, src + size.x, row(to, y));
+        touch_rows(to.y + y, to.y + y + 1);
+    };
+    // Walk away from the destination so overlapping rows are read before written
+    if (to.y > from.y)
+        for (unsigned y = size.y; y-- > 0; )
+            copy_row(y);
+    else
+        for (unsigned y = 0; y < size.y; y++)
+            copy_row(y);
+}
+
+template<typename Policy>
+void BasicTextMap<Policy>::shift_rows(Vector2u from, Vector2u to, int shift, const Cell& blank)
+{
+    unsigned count = shift > 0 ? shift : -shift;
+    unsigned width = to.x - from.x;
+    auto row = [&](unsigned y) { return &_map[y * size.x + from.x]; };
+    // Whole rows keep their hash, partial rows are rehashed on demand
+    bool whole = from.x == 0 and to.x == size.x;
+    auto move_row = [&](unsigned dst, unsigned src) {
+        std::copy_n(row(src), width, row(dst));
+        _row_hash[dst] = whole ? _row_hash[src] : stale_hash;
+        damage_rows(dst, dst + 1);
+    };
+    auto clear_row = [&](unsigned y) {
+        std::fill_n(row(y), width, blank);
+        touch_rows(y, y + 1);
+    };
+    if (shift > 0) {
+        for (unsigned y = from.y; y + count < to.y; y++)
+            move_row(y, y + count);
+        for (unsigned y = to.y - count; y < to.y; y++)
+            clear_row(y);
+    }
+    else {
+        for (unsigned y = to.y; y-- > from.y + count; )
+            move_row(y, y - count);
+        for (unsigned y = from.y; y < from.y + count; y++)
+            clear_row(y);
+    }
+}
+
+template<typename Policy>
+BasicTextMap<Policy> BasicTextMap<Policy>::strip() const
 {
     Vector2i left_min{0x7F7F7FFF, 0x7F7F7FFF}, right_max{-1, -1};
     bool found = false;
     for (unsigned y = 0; y < size.y; y++)
         for (unsigned x = 0; x < size.x; x++)
         {
-            if (get_char({x, y}).character != L'\0') {
+            if (_map[x + y * size.x].character != 0) {
                 if ((int)x > right_max.x)
                     right_max.x = x;
                 if ((int)y > right_max.y)
@@ -132,9 +582,18 @@ TextMap TextMap::strip() const
             }
         }
     if (found) {
-        TextMap result{(right_max + Vector2i{1, 1}) - left_min};
-        draw(&result);
+        BasicTextMap result{(right_max + Vector2i{1, 1}) - left_min};
+        for (unsigned y = 0; y < result.size.y; y++)
+            result.write_cells(y, 0, row_data(y), size.x);
         return result;
     }
     return *this;
 }
+
+
+template class BasicTextMap<StandardCellPolicy>;
+template class BasicTextMap<CompactCellPolicy>;
+template class BasicTextMap<WideCellPolicy>;
+template class BasicSTDIOTextArea<StandardCellPolicy>;
+template class BasicSTDIOTextArea<CompactCellPolicy>;
+template class BasicSTDIOTextArea<WideCellPolicy>;
@@ -0,0 +1,122 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+
+
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+ThreadPool::ThreadPool(unsigned workers)
+{
+    for (unsigned i = 0; i <= workers; i++)
+        _queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < workers; i++)
+        _threads.emplace_back([this, i] { work(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& task)
+{
+    if (_threads.empty() or count < 2) {
+        for (size_t i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+
+    std::lock_guard batch(_batch);
+    {
+        // The task is published before any index, a worker still looking
+        // for work of the last batch may pick one up right away
+        std::lock_guard lock(_mutex);
+        _task = &task;
+        _pending = count;
+        _error = nullptr;
+        ++_generation;
+    }
+    for (size_t i = 0; i < count; i++) {
+        auto& queue = *_queues[i % _queues.size()];
+        std::lock_guard lock(queue.mutex);
+        queue.items.push_back(i);
+    }
+    _wake.notify_all();
+
+    while (run_one(unsigned(_queues.size() - 1)));
+
+    std::unique_lock lock(_mutex);
+    _done.wait(lock, [this] { return _pending == 0; });
+    _task = nullptr;
+    if (_error)
+        std::rethrow_exception(std::exchange(_error, nullptr));
+}
+
+void ThreadPool::work(unsigned self)
+{
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock lock(_mutex);
+            _wake.wait(lock, [&] { return _stop or _generation != seen; });
+            if (_stop)
+                return;
+            seen = _generation;
+        }
+        while (run_one(self));
+    }
+}
+
+bool ThreadPool::run_one(unsigned self)
+{
+    size_t index = 0;
+    bool found = false;
+    // Own queue from the front, the others from the back
+    {
+        auto& queue = *_queues[self];
+        std::lock_guard lock(queue.mutex);
+        if (not queue.items.empty()) {
+            index = queue.items.front();
+            queue.items.pop_front();
+            found = true;
+        }
+    }
+    for (size_t k = 1; not found and k < _queues.size(); k++) {
+        auto& queue = *_queues[(self + k) % _queues.size()];
+        std::lock_guard lock(queue.mutex);
+        if (not queue.items.empty()) {
+            index = queue.items.back();
+            queue.items.pop_back();
+            found = true;
+        }
+    }
+    if (not found)
+        return false;
+
+    try {
+        (*_task)(index);
+    }
+    catch (...) {
+        std::lock_guard lock(_mutex);
+        if (not _error)
+            _error = std::current_exception();
+    }
+
+    std::lock_guard lock(_mutex);
+    if (--_pending == 0)
+        _done.notify_all();
+    return true;
+}
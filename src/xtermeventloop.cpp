@@ -5,10 +5,14 @@
 
 
 XTermEventLoop::XTermEventLoop()
-    : receiver(mutex, queue), sender(receiver), should_exit(false) {}
+    : receiver(mutex, queue, should_exit), sender(receiver), should_exit(false) {}
 
 XTermEventLoop::~XTermEventLoop() {
-    should_exit = true;
+    {
+        std::lock_guard lg(mutex);
+        should_exit = true;
+    }
+    receiver.handed.notify_one();
     thread.join();
 }
 
@@ -16,29 +20,43 @@ void XTermEventLoop::loop() {
     fd_set fds;
     FD_ZERO(&fds);
     FD_SET(STDIN_FILENO, &fds);
+    // Sequences come split across reads on slow links, an ESC is only
+    // the Escape key once nothing followed it for a moment
+    bool pending = sender.pending();
     timeval tv;
-    tv.tv_usec = 0;
-    tv.tv_sec = 1;
-    char buffer[128];
+    tv.tv_usec = pending ? escape_timeout_us : 0;
+    tv.tv_sec = pending ? 0 : 1;
+    char buffer[1 << 16];
     auto recl = select(1, &fds, nullptr, nullptr, &tv);
     switch(recl)
     {
-    case 0: break;
+    case 0:
+        if (pending)
+            sender.on_idle();
+        break;
     case -1: break;
     default:
-        if (auto s = read(STDIN_FILENO, buffer, sizeof(buffer)); s > 0) {
-            for (size_t i = 0; i < s; i++)
-                sender.on_char(buffer[i]);
-        }
+        if (auto s = read(STDIN_FILENO, buffer, sizeof(buffer)); s > 0)
+            sender.on_bytes({buffer, size_t(s)});
     }
 }
 
 bool XTermEventLoop::poll(ConsoleEventReceiver &recv) {
     AnyConsoleEvent event;
     {
-        std::lock_guard lg(mutex);
-        if (queue.empty())
-            return false;
+        std::unique_lock lock(mutex);
+        if (queue.empty()) {
+            // Everything queued came before the paste, its reader waits for us
+            auto paste = receiver.paste;
+            if (not paste)
+                return false;
+            lock.unlock();
+            recv.on_event(*paste);
+            lock.lock();
+            receiver.paste = nullptr;
+            receiver.handed.notify_one();
+            return true;
+        }
         event = std::move(queue.front());
         queue.pop();
     }